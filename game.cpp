@@ -2,1025 +2,7062 @@
 #include <deque>
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
 #include <ctime>
 #include <unistd.h>
 #include <termios.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <fstream>
 #include <sys/ioctl.h>
 #include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 using namespace std;
 
+// ============ Lock-free SPSC Queue ============
+// Single-producer/single-consumer ring; N must be a power of two.
+template <typename T, size_t N>
+class SpscQueue
+{
+private:
+    T items[N];
+    atomic<size_t> head; // Next slot to pop (consumer)
+    atomic<size_t> tail; // Next slot to push (producer)
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(const T &item)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == N)
+            return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire))
+            return false;
+        item = items[h & (N - 1)];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+};
+
 // ============ Sound System ============
+enum SoundEvent
+{
+    SOUND_EAT = 1,
+    SOUND_POWERUP = 2,
+    SOUND_COLLISION = 4,
+    SOUND_GAME_OVER = 8
+};
+
+// Terminal bell patterns played by a background worker. The game thread only
+// enqueues event ids; bursts that pile up while a pattern plays are coalesced
+// into the most important one.
 class SoundManager
 {
-public:
-    static void playSound(const string &event)
+private:
+    SpscQueue<unsigned char, 64> events;
+    mutex lock;
+    condition_variable wake;
+    bool running;
+    bool pending; // Set under lock by play(), so a wakeup can't slip past the worker
+    thread worker;
+
+    static void bell()
     {
-        // Cross-platform beep using terminal bell
-        if (event == "eat")
-        {
-            cout << "\a" << flush; // Single beep for food
-        }
-        else if (event == "powerup")
+        if (write(STDOUT_FILENO, "\a", 1) < 0)
         {
-            cout << "\a" << flush;
-            usleep(50000);
-            cout << "\a" << flush; // Double beep for powerup
+            // Nowhere to report a failed bell
         }
-        else if (event == "gameover")
+    }
+
+    static void playPattern(int mask)
+    {
+        if (mask & SOUND_GAME_OVER)
         {
             for (int i = 0; i < 3; ++i)
             {
-                cout << "\a" << flush;
+                bell();
                 usleep(100000);
             }
         }
-        else if (event == "collision")
+        else if (mask & SOUND_POWERUP)
         {
-            cout << "\a" << flush;
+            bell();
+            usleep(50000);
+            bell(); // Double beep for powerup
+        }
+        else if (mask & (SOUND_EAT | SOUND_COLLISION))
+        {
+            bell(); // Single beep for food or a hit
         }
     }
-};
-
-struct Point
-{
-    int x, y;
 
-    Point(int x = 0, int y = 0) : x(x), y(y) {}
-
-    bool operator==(const Point &other) const
+    int drain()
     {
-        return x == other.x && y == other.y;
+        int mask = 0;
+        unsigned char event;
+        while (events.pop(event))
+            mask |= event;
+        return mask;
     }
-};
-
-// ============ PowerUp System ============
-enum PowerUpType
-{
-    SPEED_BOOST,   // Faster movement
-    SLOW_DOWN,     // Slower movement
-    SCORE_DOUBLE,  // Double points for limited time
-    INVINCIBILITY, // Can't die from obstacles/walls temporarily
-    SHRINK         // Remove last segment
-};
-
-class PowerUp
-{
-private:
-    Point position;
-    PowerUpType type;
-    int duration; // Duration in game ticks
-    bool active;
-    int remainingTime; // Remaining active time
-
-public:
-    PowerUp() : position(0, 0), type(SPEED_BOOST), duration(0), active(false), remainingTime(0) {}
 
-    void spawn(int gridWidth, int gridHeight, const deque<Point> &snakeBody,
-               const vector<Point> &obstacles, const vector<Point> &foodPositions)
+    void loop()
     {
-        bool validPosition;
-        do
+        while (true)
         {
-            validPosition = true;
-            position.x = rand() % gridWidth;
-            position.y = rand() % gridHeight;
-
-            // Check snake collision
-            for (const auto &segment : snakeBody)
             {
-                if (position == segment)
-                {
-                    validPosition = false;
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [this] { return pending || !running; });
+                if (!running)
                     break;
-                }
+                pending = false;
             }
+            playPattern(drain());
+        }
+        playPattern(drain());
+    }
 
-            // Check obstacle collision
-            if (validPosition)
-            {
-                for (const auto &obs : obstacles)
-                {
-                    if (position == obs)
-                    {
-                        validPosition = false;
-                        break;
-                    }
-                }
-            }
+public:
+    SoundManager() : running(false), pending(false) {}
 
-            // Check food collision
-            if (validPosition)
-            {
-                for (const auto &food : foodPositions)
-                {
-                    if (position == food)
-                    {
-                        validPosition = false;
-                        break;
-                    }
-                }
-            }
-        } while (!validPosition);
+    ~SoundManager() { stop(); }
 
-        // Randomly select powerup type
-        type = static_cast<PowerUpType>(rand() % 5);
-        duration = 100; // 100 ticks duration for time-based powerups
-        active = true;
-        remainingTime = 0;
+    void start()
+    {
+        if (running)
+            return;
+        running = true;
+        worker = thread(&SoundManager::loop, this);
     }
 
-    Point getPosition() const { return position; }
-    PowerUpType getType() const { return type; }
-    bool isActive() const { return active; }
-    void deactivate() { active = false; }
-    int getRemainingTime() const { return remainingTime; }
-
-    void startEffect() { remainingTime = duration; }
-    bool updateEffect()
+    void stop()
     {
-        if (remainingTime > 0)
+        if (!running)
+            return;
         {
-            remainingTime--;
-            return true;
+            lock_guard<mutex> guard(lock);
+            running = false;
         }
-        return false;
+        wake.notify_one();
+        worker.join();
     }
 
-    char getSymbol() const
+    // Never blocks on audio: queues the event and wakes the worker
+    void play(SoundEvent event)
     {
-        switch (type)
+        events.push(event);
         {
-        case SPEED_BOOST:
-            return 'S';
-        case SLOW_DOWN:
-            return 'L';
-        case SCORE_DOUBLE:
-            return 'D';
-        case INVINCIBILITY:
-            return 'I';
-        case SHRINK:
-            return 'R';
-        default:
-            return 'P';
+            lock_guard<mutex> guard(lock);
+            pending = true;
         }
+        wake.notify_one();
     }
+};
 
-    string getName() const
+struct Point
+{
+    int x, y;
+
+    Point(int x = 0, int y = 0) : x(x), y(y) {}
+
+    bool operator==(const Point &other) const
     {
-        switch (type)
-        {
-        case SPEED_BOOST:
-            return "Speed Boost";
-        case SLOW_DOWN:
-            return "Slow Motion";
-        case SCORE_DOUBLE:
-            return "Double Score";
-        case INVINCIBILITY:
-            return "Invincibility";
-        case SHRINK:
-            return "Shrink";
-        default:
-            return "PowerUp";
-        }
+        return x == other.x && y == other.y;
     }
 };
 
-// ============ Obstacle Class ============
-class Obstacle
+// ============ Random Number Generator ============
+// xoshiro256** seeded through splitmix64. One generator per game keeps runs
+// reproducible from a seed and lets parallel games run without shared state.
+class Rng
 {
 private:
-    vector<Point> positions;
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
 
 public:
-    Obstacle() {}
+    Rng(uint64_t seed = 1) { reseed(seed); }
 
-    void generateObstacles(int gridWidth, int gridHeight, const Point &snakeStart)
+    void reseed(uint64_t seed)
     {
-        positions.clear();
-        int numObstacles = (gridWidth * gridHeight) / 50;
-
-        for (int i = 0; i < numObstacles; ++i)
+        for (int i = 0; i < 4; ++i)
         {
-            int x = rand() % gridWidth;
-            int y = rand() % gridHeight;
-            Point obs(x, y);
-
-            if (abs(x - snakeStart.x) > 3 && abs(y - snakeStart.y) > 3)
-            {
-                positions.push_back(obs);
-            }
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            state[i] = z ^ (z >> 31);
         }
     }
 
-    bool isObstacle(const Point &p) const
+    uint64_t next()
     {
-        for (const auto &obs : positions)
-        {
-            if (obs == p)
-                return true;
-        }
-        return false;
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
     }
 
-    const vector<Point> &getPositions() const
+    // Uniform integer in [0, n) by multiply-shift on the top 32 bits
+    int uniform(int n)
     {
-        return positions;
+        return (int)(((next() >> 32) * (uint64_t)n) >> 32);
     }
+
+    // Raw generator state, for snapshots
+    void getState(uint64_t out[4]) const { copy(state, state + 4, out); }
+    void setState(const uint64_t in[4]) { copy(in, in + 4, state); }
 };
 
-// ============ Food Class (Multiple Foods Support) ============
-class FoodManager
+// ============ Board Occupancy Grid ============
+enum CellFlag
 {
-private:
-    vector<Point> foodPositions;
-    int maxFoods;
-
-public:
-    FoodManager(int max = 3) : maxFoods(max) {}
-
-    void spawnFood(int gridWidth, int gridHeight, const deque<Point> &snakeBody,
-                   const Obstacle &obstacles, const vector<PowerUp> &powerups)
-    {
-        if (foodPositions.size() >= maxFoods)
-            return;
-
-        bool validPosition;
-        Point newFood;
-        do
-        {
-            validPosition = true;
-            newFood.x = rand() % gridWidth;
-            newFood.y = rand() % gridHeight;
+    CELL_EMPTY = 0,
+    CELL_OBSTACLE = 1,
+    CELL_FOOD = 2,
+    CELL_POWERUP = 4
+};
 
-            // Check snake collision
-            for (const auto &segment : snakeBody)
-            {
-                if (newFood == segment)
-                {
-                    validPosition = false;
-                    break;
-                }
-            }
+class Board
+{
+private:
+    int width;
+    int height;
+    vector<unsigned char> cells;       // CellFlag bits per cell
+    vector<unsigned short> snakeCount; // Segments per cell (overlap while invincible)
+    vector<unsigned char> headCount;   // Snake heads per cell, so views needn't walk every snake
+    vector<int> freeCells;             // Dense list of free cell indices
+    vector<int> freeSlot;              // Cell index -> slot in freeCells, -1 if occupied
 
-            // Check obstacle collision
-            if (validPosition && obstacles.isObstacle(newFood))
-            {
-                validPosition = false;
-            }
+    // Same state as bitsets, 64 cells per word with rows padded to whole words
+    int wordsPerRow;
+    vector<uint64_t> passableBits; // No obstacle and no snake
+    vector<uint64_t> freeBits;     // Nothing at all
 
-            // Check existing food collision
-            if (validPosition)
-            {
-                for (const auto &food : foodPositions)
-                {
-                    if (newFood == food)
-                    {
-                        validPosition = false;
-                        break;
-                    }
-                }
-            }
+    bool trackingChanges;
+    vector<int> changed; // Cells touched since clearChanges(), for incremental redraw
 
-            // Check powerup collision
-            if (validPosition)
-            {
-                for (const auto &powerup : powerups)
-                {
-                    if (powerup.isActive() && newFood == powerup.getPosition())
-                    {
-                        validPosition = false;
-                        break;
-                    }
-                }
-            }
-        } while (!validPosition);
+    int index(const Point &p) const { return p.y * width + p.x; }
 
-        foodPositions.push_back(newFood);
+    static void setBit(vector<uint64_t> &bits, size_t word, int bit, bool on)
+    {
+        if (on)
+            bits[word] |= 1ULL << bit;
+        else
+            bits[word] &= ~(1ULL << bit);
     }
 
-    void initializeFoods(int gridWidth, int gridHeight, const deque<Point> &snakeBody,
-                         const Obstacle &obstacles, const vector<PowerUp> &powerups)
+    // Keep the free-cell list and bitsets in sync after a cell changed (swap-remove on fill)
+    void updateFree(int i)
     {
-        foodPositions.clear();
-        for (int i = 0; i < maxFoods; ++i)
+        bool free = cells[i] == CELL_EMPTY && snakeCount[i] == 0;
+        size_t word = (i / width) * wordsPerRow + (i % width) / 64;
+        int bit = (i % width) % 64;
+        setBit(passableBits, word, bit, !(cells[i] & CELL_OBSTACLE) && snakeCount[i] == 0);
+        setBit(freeBits, word, bit, free);
+        if (trackingChanges)
+            changed.push_back(i);
+
+        if (free && freeSlot[i] < 0)
+        {
+            freeSlot[i] = freeCells.size();
+            freeCells.push_back(i);
+        }
+        else if (!free && freeSlot[i] >= 0)
         {
-            spawnFood(gridWidth, gridHeight, snakeBody, obstacles, powerups);
+            int last = freeCells.back();
+            freeCells[freeSlot[i]] = last;
+            freeSlot[last] = freeSlot[i];
+            freeCells.pop_back();
+            freeSlot[i] = -1;
         }
     }
 
-    bool checkAndRemoveFood(const Point &position)
+public:
+    Board() : width(0), height(0), wordsPerRow(0), trackingChanges(false) {}
+
+    void reset(int gridWidth, int gridHeight)
     {
-        for (auto it = foodPositions.begin(); it != foodPositions.end(); ++it)
+        width = gridWidth;
+        height = gridHeight;
+        trackingChanges = false;
+        changed.clear();
+        cells.assign(width * height, CELL_EMPTY);
+        snakeCount.assign(width * height, 0);
+        headCount.assign(width * height, 0);
+
+        freeCells.resize(width * height);
+        freeSlot.resize(width * height);
+        for (int i = 0; i < width * height; ++i)
         {
-            if (*it == position)
+            freeCells[i] = i;
+            freeSlot[i] = i;
+        }
+
+        wordsPerRow = (width + 63) / 64;
+        passableBits.assign(wordsPerRow * height, 0);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int w = 0; w < wordsPerRow; ++w)
             {
-                foodPositions.erase(it);
-                return true;
+                int bits = min(64, width - w * 64);
+                passableBits[y * wordsPerRow + w] = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
             }
         }
-        return false;
+        freeBits = passableBits;
     }
 
-    const vector<Point> &getFoodPositions() const
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getWordsPerRow() const { return wordsPerRow; }
+    const uint64_t *passableRow(int y) const { return &passableBits[y * wordsPerRow]; }
+    const uint64_t *freeRow(int y) const { return &freeBits[y * wordsPerRow]; }
+
+    // Record touched cell indices so a renderer can repaint only what changed.
+    // A tick touches a handful of cells, so the reserve keeps ticks allocation-free.
+    void setChangeTracking(bool enabled)
     {
-        return foodPositions;
+        trackingChanges = enabled;
+        changed.clear();
+        if (enabled)
+            changed.reserve(64);
     }
+    const vector<int> &getChanges() const { return changed; }
+    void clearChanges() { changed.clear(); }
 
-    bool isFoodAt(const Point &p) const
+    bool inBounds(const Point &p) const
     {
-        for (const auto &food : foodPositions)
-        {
-            if (food == p)
-                return true;
-        }
-        return false;
+        return p.x >= 0 && p.x < width && p.y >= 0 && p.y < height;
     }
-};
-
-// ============ Snake Class ============
-class Snake
-{
-private:
-    deque<Point> body;
-    Point direction;
-    Point nextDirection;
-    bool growing;
 
-public:
-    Snake(int startX, int startY) : direction(1, 0), nextDirection(1, 0), growing(false)
+    bool has(const Point &p, CellFlag flag) const
     {
-        body.push_back(Point(startX, startY));
-        body.push_back(Point(startX - 1, startY));
-        body.push_back(Point(startX - 2, startY));
+        return inBounds(p) && (cells[index(p)] & flag);
     }
 
-    void setDirection(int dx, int dy)
+    void set(const Point &p, CellFlag flag)
     {
-        if (dx != -direction.x || dy != -direction.y)
+        if (inBounds(p))
         {
-            nextDirection.x = dx;
-            nextDirection.y = dy;
+            cells[index(p)] |= flag;
+            updateFree(index(p));
         }
     }
 
-    void move()
+    void clear(const Point &p, CellFlag flag)
     {
-        direction = nextDirection;
-
-        Point newHead(body.front().x + direction.x, body.front().y + direction.y);
-        body.push_front(newHead);
-
-        if (!growing)
-        {
-            body.pop_back();
-        }
-        else
+        if (inBounds(p))
         {
-            growing = false;
+            cells[index(p)] &= ~flag;
+            updateFree(index(p));
         }
     }
 
-    void grow()
+    // Out-of-bounds segments (invincible snake past a wall) are not tracked
+    void addSnake(const Point &p)
     {
-        growing = true;
+        if (inBounds(p))
+        {
+            snakeCount[index(p)]++;
+            updateFree(index(p));
+        }
     }
 
-    void shrink()
+    void removeSnake(const Point &p)
     {
-        if (body.size() > 3) // Keep minimum length
+        if (inBounds(p))
         {
-            body.pop_back();
+            snakeCount[index(p)]--;
+            updateFree(index(p));
         }
     }
 
-    Point getHead() const
+    int snakeAt(const Point &p) const
     {
-        return body.front();
+        return inBounds(p) ? snakeCount[index(p)] : 0;
     }
 
-    const deque<Point> &getBody() const
+    // Heads sit on snake cells already, so they don't touch the free list
+    void addHead(const Point &p)
     {
-        return body;
+        if (inBounds(p))
+            headCount[index(p)]++;
     }
 
-    bool checkSelfCollision() const
+    void removeHead(const Point &p)
     {
-        Point head = body.front();
-        for (size_t i = 1; i < body.size(); ++i)
-        {
-            if (head == body[i])
-            {
-                return true;
-            }
-        }
-        return false;
+        if (inBounds(p))
+            headCount[index(p)]--;
     }
-};
-
-// ============ HighScore Manager ============
-class HighScoreManager
-{
-private:
-    const string filename = "snake_highscore.dat";
-    int highScore;
 
-public:
-    HighScoreManager() : highScore(0)
+    bool headAt(const Point &p) const
     {
-        loadHighScore();
+        return inBounds(p) && headCount[index(p)] > 0;
     }
 
-    void loadHighScore()
+    bool isFree(const Point &p) const
     {
-        ifstream file(filename);
-        if (file.is_open())
-        {
-            file >> highScore;
-            file.close();
-        }
-        else
-        {
-            highScore = 0;
-        }
+        return inBounds(p) && freeSlot[index(p)] >= 0;
     }
 
-    void saveHighScore(int score)
+    int freeCount() const { return freeCells.size(); }
+
+    // The free list's order decides where random picks land, so snapshots
+    // carry it to make a resumed game play out exactly like the original
+    const int *freeCellOrder() const { return freeCells.data(); }
+
+    bool restoreFreeCellOrder(const int *order, size_t count)
     {
-        if (score > highScore)
+        if (count != freeCells.size())
+            return false;
+        vector<bool> seen(width * height, false);
+        for (size_t i = 0; i < count; ++i)
         {
-            highScore = score;
-            ofstream file(filename);
-            if (file.is_open())
-            {
-                file << highScore;
-                file.close();
-            }
+            int c = order[i];
+            if (c < 0 || c >= width * height || freeSlot[c] < 0 || seen[c])
+                return false;
+            seen[c] = true;
         }
+        freeCells.assign(order, order + count);
+        for (size_t i = 0; i < count; ++i)
+            freeSlot[freeCells[i]] = i;
+        return true;
     }
 
-    int getHighScore() const
+    // Uniform pick among free cells; false when the board is full
+    bool randomFreeCell(Rng &rng, Point &out) const
     {
-        return highScore;
+        if (freeCells.empty())
+            return false;
+        int i = freeCells[rng.uniform(freeCells.size())];
+        out = Point(i % width, i / width);
+        return true;
     }
 };
 
-// ============ Game Class ============
-class Game
+// ============ Reachability ============
+// Spread gen through runs of set bits in pro, towards higher / lower bits
+static inline uint64_t fillUp(uint64_t gen, uint64_t pro)
 {
-private:
-    int WIDTH;
-    int HEIGHT;
-    Snake *snake;
-    FoodManager foodManager;
-    Obstacle obstacles;
-    vector<PowerUp> powerups;
-    int score;
-    int baseSpeed;
-    int currentSpeed;
-    bool gameOver;
-    struct termios oldt, newt;
-    HighScoreManager highScoreManager;
-    vector<string> screenBuffer;
-    vector<string> previousBuffer;
+    gen |= pro & (gen << 1);
+    pro &= pro << 1;
+    gen |= pro & (gen << 2);
+    pro &= pro << 2;
+    gen |= pro & (gen << 4);
+    pro &= pro << 4;
+    gen |= pro & (gen << 8);
+    pro &= pro << 8;
+    gen |= pro & (gen << 16);
+    pro &= pro << 16;
+    return gen | (pro & (gen << 32));
+}
 
-    // Active powerup effects
-    bool invincibilityActive;
-    bool doubleScoreActive;
-    int invincibilityTimer;
-    int doubleScoreTimer;
+static inline uint64_t fillDown(uint64_t gen, uint64_t pro)
+{
+    gen |= pro & (gen >> 1);
+    pro &= pro >> 1;
+    gen |= pro & (gen >> 2);
+    pro &= pro >> 2;
+    gen |= pro & (gen >> 4);
+    pro &= pro >> 4;
+    gen |= pro & (gen >> 8);
+    pro &= pro >> 8;
+    gen |= pro & (gen >> 16);
+    pro &= pro >> 16;
+    return gen | (pro & (gen >> 32));
+}
 
-    void setupTerminal()
-    {
-        tcgetattr(STDIN_FILENO, &oldt);
-        newt = oldt;
-        newt.c_lflag &= ~(ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+// Board with compile-time dimensions, one word per row. Every loop has a
+// constant trip count, so the compiler unrolls the sweeps and keeps small
+// boards entirely in registers.
+template <int W, int H>
+class Bitboard
+{
+    static_assert(W > 0 && W <= 64 && H > 0, "fixed bitboards hold one 64-bit word per row");
 
-        int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-        fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-    }
+private:
+    uint64_t rows[H];
 
-    void restoreTerminal()
+    // Pull reach in from a neighbouring row and fill it sideways; true if anything was added
+    bool spread(int y, uint64_t from, uint64_t pass)
     {
-        tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-
-        int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-        fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+        uint64_t grow = from & pass & ~rows[y];
+        if (!grow)
+            return false;
+        rows[y] = fillDown(fillUp(rows[y] | grow, pass), pass);
+        return true;
     }
 
-    void getTerminalSize()
-    {
-        struct winsize w;
-        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+public:
+    static bool fits(int width, int height) { return width <= W && height <= H; }
 
-        WIDTH = min(60, (int)w.ws_col - 4);
-        HEIGHT = min(30, (int)w.ws_row - 10);
+    void clear() { fill(rows, rows + H, 0); }
 
-        if (WIDTH < 20)
-            WIDTH = 20;
-        if (HEIGHT < 15)
-            HEIGHT = 15;
-    }
+    void set(int x, int y) { rows[y] |= 1ULL << x; }
 
-    void clearScreen()
+    // Copy `height` one-word rows; rows past the board stay empty
+    void load(const uint64_t *src, int height)
     {
-        cout << "\033[2J\033[H";
+        for (int y = 0; y < H; ++y)
+            rows[y] = y < height ? src[y] : 0;
     }
 
-    void moveCursor(int row, int col)
-    {
-        cout << "\033[" << row << ";" << col << "H";
-    }
+    void store(uint64_t *dst, int height) const { copy(rows, rows + height, dst); }
 
-    void hideCursor()
+    // Grow the set bits to every cell of pass 4-connected to them
+    void floodWithin(const Bitboard &pass)
     {
-        cout << "\033[?25l";
-    }
+        for (int y = 0; y < H; ++y)
+        {
+            if (rows[y])
+                rows[y] = fillDown(fillUp(rows[y], pass.rows[y]), pass.rows[y]);
+        }
 
-    void showCursor()
-    {
-        cout << "\033[?25h";
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (int y = 1; y < H; ++y)
+                changed |= spread(y, rows[y - 1], pass.rows[y]);
+            for (int y = H - 2; y >= 0; --y)
+                changed |= spread(y, rows[y + 1], pass.rows[y]);
+        }
     }
+};
 
-    void initializeBuffer()
-    {
-        screenBuffer.clear();
-        previousBuffer.clear();
+// Word-parallel flood fill over the board's passable bitset, 64 cells per
+// word. Each row is filled sideways with shift/AND occluded fills, and rows
+// are swept downwards then upwards until a sweep adds nothing. Boards that
+// fit a tournament size run on the matching Bitboard specialization.
+class ReachabilityMap
+{
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    vector<uint64_t> reach;
+    bool valid;
+    bool specialized; // Use fixed-size Bitboard fills where the board fits one
 
-        // Top border
-        string topBorder = "+";
-        for (int i = 0; i < WIDTH; ++i)
-            topBorder += "-";
-        topBorder += "+";
-        screenBuffer.push_back(topBorder);
+    // Boards up to this many cells flood in prepare(); bigger ones defer the
+    // flood until pickFreeCell's local searches all miss
+    static const long long LAZY_FLOOD_AREA = 256 * 256;
+    // Local searches stay inside a WINDOW x WINDOW square around their start,
+    // one word per row
+    static const int WINDOW = 64;
+    Point origin;
+    bool deferred;         // prepare() skipped the flood; reach is stale
+    bool originSealed;     // The origin's whole region fits its window: pocket lists it
+    vector<Point> pocket;
+    uint64_t window[WINDOW];
+    vector<Point> frontier;
 
-        // Game area
-        for (int y = 0; y < HEIGHT; ++y)
+    // Depth-first search from start; true once it reaches target or leaves
+    // the window. Depth-first leaves an open window in about WINDOW / 2 steps.
+    // Visited cells are appended to `visited` when given.
+    bool escapes(const Board &board, const Point &start, const Point &target, vector<Point> *visited)
+    {
+        static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        int left = start.x - WINDOW / 2;
+        int top = start.y - WINDOW / 2;
+        memset(window, 0, sizeof(window));
+        window[start.y - top] |= 1ULL << (start.x - left);
+        frontier.clear();
+        frontier.push_back(start);
+        while (!frontier.empty())
         {
-            string line = "|";
-            for (int x = 0; x < WIDTH; ++x)
+            Point cell = frontier.back();
+            frontier.pop_back();
+            for (const auto &d : dirs)
             {
-                line += " ";
+                Point n(cell.x + d[0], cell.y + d[1]);
+                if (n == target)
+                    return true;
+                if (!board.inBounds(n) || !((board.passableRow(n.y)[n.x / 64] >> (n.x % 64)) & 1))
+                    continue;
+                int wx = n.x - left;
+                int wy = n.y - top;
+                if (wx < 0 || wx >= WINDOW || wy < 0 || wy >= WINDOW)
+                    return true;
+                if (window[wy] >> wx & 1)
+                    continue;
+                window[wy] |= 1ULL << wx;
+                frontier.push_back(n);
+                if (visited)
+                    visited->push_back(n);
             }
-            line += "|";
-            screenBuffer.push_back(line);
         }
-
-        // Bottom border
-        string bottomBorder = "+";
-        for (int i = 0; i < WIDTH; ++i)
-            bottomBorder += "-";
-        bottomBorder += "+";
-        screenBuffer.push_back(bottomBorder);
-
-        // Status lines
-        screenBuffer.push_back("");
-        screenBuffer.push_back("");
-        screenBuffer.push_back("Controls: W/A/S/D or Arrow Keys | Q to quit");
-
-        previousBuffer = screenBuffer;
+        return false;
     }
 
-    void updateBuffer()
+    // Uniform pick among the free cells of the origin's sealed pocket
+    bool pickInPocket(const Board &board, Rng &rng, Point &out) const
     {
-        // Reset game area to spaces
-        for (int y = 0; y < HEIGHT; ++y)
+        int total = 0;
+        for (const auto &p : pocket)
+            total += board.isFree(p);
+        if (total == 0)
+            return board.randomFreeCell(rng, out);
+        int pick = rng.uniform(total);
+        for (const auto &p : pocket)
         {
-            for (int x = 0; x < WIDTH; ++x)
+            if (board.isFree(p) && pick-- == 0)
             {
-                screenBuffer[y + 1][x + 1] = ' ';
+                out = p;
+                return true;
             }
         }
+        return false;
+    }
 
-        // Draw obstacles
-        for (const auto &obs : obstacles.getPositions())
+    // Fill one row sideways, carrying across word boundaries in both directions
+    void fillRow(uint64_t *row, const uint64_t *pass)
+    {
+        for (int k = 0; k < wordsPerRow; ++k)
         {
-            if (obs.x >= 0 && obs.x < WIDTH && obs.y >= 0 && obs.y < HEIGHT)
-            {
-                screenBuffer[obs.y + 1][obs.x + 1] = '#';
-            }
+            uint64_t v = row[k];
+            if (k > 0 && (row[k - 1] >> 63))
+                v |= pass[k] & 1;
+            row[k] = fillDown(fillUp(v, pass[k]), pass[k]);
         }
-
-        // Draw multiple foods
-        for (const auto &foodPos : foodManager.getFoodPositions())
+        for (int k = wordsPerRow - 1; k >= 0; --k)
         {
-            if (foodPos.x >= 0 && foodPos.x < WIDTH && foodPos.y >= 0 && foodPos.y < HEIGHT)
-            {
-                screenBuffer[foodPos.y + 1][foodPos.x + 1] = '*';
-            }
+            uint64_t v = row[k];
+            if (k + 1 < wordsPerRow && (row[k + 1] & 1))
+                v |= pass[k] & (1ULL << 63);
+            row[k] = fillDown(fillUp(v, pass[k]), pass[k]);
         }
+    }
 
-        // Draw powerups
-        for (const auto &powerup : powerups)
-        {
-            if (powerup.isActive())
-            {
-                Point pos = powerup.getPosition();
-                if (pos.x >= 0 && pos.x < WIDTH && pos.y >= 0 && pos.y < HEIGHT)
-                {
-                    screenBuffer[pos.y + 1][pos.x + 1] = powerup.getSymbol();
-                }
-            }
-        }
+    // Pull reach in from a neighbouring row; true if anything was added
+    bool spreadFrom(int y, int fromY, const Board &board)
+    {
+        uint64_t *row = &reach[y * wordsPerRow];
+        const uint64_t *from = &reach[fromY * wordsPerRow];
+        const uint64_t *pass = board.passableRow(y);
 
-        // Draw snake
-        const deque<Point> &body = snake->getBody();
-        for (size_t i = 0; i < body.size(); ++i)
+        bool added = false;
+        for (int k = 0; k < wordsPerRow; ++k)
         {
-            if (body[i].x >= 0 && body[i].x < WIDTH && body[i].y >= 0 && body[i].y < HEIGHT)
+            uint64_t grow = from[k] & pass[k] & ~row[k];
+            if (grow)
             {
-                if (i == 0)
-                    screenBuffer[body[i].y + 1][body[i].x + 1] = 'O';
-                else
-                    screenBuffer[body[i].y + 1][body[i].x + 1] = 'o';
+                row[k] |= grow;
+                added = true;
             }
         }
+        if (added)
+            fillRow(row, pass);
+        return added;
+    }
 
-        // Update status lines
-        stringstream ss1;
-        ss1 << "Score: " << score << " | High Score: " << highScoreManager.getHighScore();
-        screenBuffer[HEIGHT + 2] = ss1.str();
+    template <int W, int H>
+    void computeFixed(const Board &board, const Point &from)
+    {
+        Bitboard<W, H> pass, filled;
+        pass.load(board.passableRow(0), height);
+        filled.clear();
+        filled.set(from.x, from.y);
+        filled.floodWithin(pass);
+        filled.store(reach.data(), height);
+    }
+
+    // Smallest tournament size that holds the board; false for the generic fill
+    bool dispatchFixed(const Board &board, const Point &from)
+    {
+        if (Bitboard<20, 15>::fits(width, height))
+            computeFixed<20, 15>(board, from);
+        else if (Bitboard<40, 25>::fits(width, height))
+            computeFixed<40, 25>(board, from);
+        else if (Bitboard<60, 30>::fits(width, height))
+            computeFixed<60, 30>(board, from);
+        else if (Bitboard<64, 64>::fits(width, height))
+            computeFixed<64, 64>(board, from);
+        else
+            return false;
+        return true;
+    }
 
-        stringstream ss2;
-        ss2 << "Active Effects: ";
-        if (invincibilityActive)
-            ss2 << "[INVINCIBLE:" << invincibilityTimer << "] ";
-        if (doubleScoreActive)
-            ss2 << "[DOUBLE SCORE:" << doubleScoreTimer << "] ";
-        if (!invincibilityActive && !doubleScoreActive)
-            ss2 << "None";
-        screenBuffer[HEIGHT + 3] = ss2.str();
+public:
+    ReachabilityMap()
+        : width(0), height(0), wordsPerRow(0), valid(false), specialized(true), deferred(false),
+          originSealed(false)
+    {
+        frontier.reserve(WINDOW * WINDOW);
+        pocket.reserve(WINDOW * WINDOW);
     }
 
-    void draw()
+    // Force the generic fill, for benchmarks and cross-checks
+    void setSpecialized(bool enabled) { specialized = enabled; }
+
+    // Cells reachable from `from`, which itself may be blocked (the snake's head)
+    void compute(const Board &board, const Point &from)
     {
-        updateBuffer();
+        deferred = false;
+        width = board.getWidth();
+        height = board.getHeight();
+        wordsPerRow = board.getWordsPerRow();
+        reach.assign(wordsPerRow * height, 0);
+        valid = board.inBounds(from);
+        if (!valid || (specialized && dispatchFixed(board, from)))
+            return;
 
-        for (size_t i = 0; i < screenBuffer.size(); ++i)
+        reach[from.y * wordsPerRow + from.x / 64] |= 1ULL << (from.x % 64);
+        fillRow(&reach[from.y * wordsPerRow], board.passableRow(from.y));
+
+        bool changed = true;
+        while (changed)
         {
-            if (screenBuffer[i] != previousBuffer[i])
-            {
-                moveCursor(i + 1, 1);
-                cout << screenBuffer[i];
-                cout.flush();
-                previousBuffer[i] = screenBuffer[i];
-            }
+            changed = false;
+            for (int y = 1; y < height; ++y)
+                changed |= spreadFrom(y, y - 1, board);
+            for (int y = height - 2; y >= 0; --y)
+                changed |= spreadFrom(y, y + 1, board);
         }
     }
 
-    void drawFullScreen()
+    // For spawning only: like compute(), but on big boards the whole-board
+    // flood waits until pickFreeCell needs it, keeping eat ticks O(1) in area.
+    // A candidate counts as reachable when a local search from it reaches the
+    // origin or leaves its window, so only pockets that fit a window are
+    // treated as sealed. An origin boxed into such a pocket spawns inside it.
+    void prepare(const Board &board, const Point &from)
     {
-        clearScreen();
-        for (const auto &line : screenBuffer)
+        if ((long long)board.getWidth() * board.getHeight() <= LAZY_FLOOD_AREA)
         {
-            cout << line << endl;
+            compute(board, from);
+            return;
         }
-        cout.flush();
+        width = board.getWidth();
+        height = board.getHeight();
+        wordsPerRow = board.getWordsPerRow();
+        valid = board.inBounds(from);
+        origin = from;
+        deferred = true;
+        pocket.clear();
+        originSealed = valid && !escapes(board, from, Point(-1, -1), &pocket);
     }
 
-    char getInput()
+    bool isValid() const { return valid; }
+
+    bool reachable(const Point &p) const
     {
-        char c = 0;
-        read(STDIN_FILENO, &c, 1);
+        return valid && p.x >= 0 && p.x < width && p.y >= 0 && p.y < height &&
+               (reach[p.y * wordsPerRow + p.x / 64] >> (p.x % 64)) & 1;
+    }
 
-        if (c == 27)
+    // True when no passable cell lies outside the reached region
+    bool coversAllPassable(const Board &board) const
+    {
+        for (int y = 0; y < height; ++y)
         {
-            char seq[2];
-            if (read(STDIN_FILENO, &seq[0], 1) == 1)
+            const uint64_t *pass = board.passableRow(y);
+            for (int k = 0; k < wordsPerRow; ++k)
             {
-                if (seq[0] == '[')
-                {
-                    if (read(STDIN_FILENO, &seq[1], 1) == 1)
-                    {
-                        if (seq[1] == 'A')
-                            return 'w';
-                        if (seq[1] == 'B')
-                            return 's';
-                        if (seq[1] == 'C')
-                            return 'd';
-                        if (seq[1] == 'D')
-                            return 'a';
-                    }
-                }
+                if (pass[k] & ~reach[y * wordsPerRow + k])
+                    return false;
             }
         }
-
-        return c;
+        return true;
     }
 
-    void processInput(char input)
+    // Passable cells outside the reached region, e.g. pockets walled off by obstacles
+    void unreachedCells(const Board &board, vector<Point> &out) const
     {
-        switch (input)
+        out.clear();
+        for (int y = 0; y < height; ++y)
         {
-        case 'w':
-        case 'W':
-            snake->setDirection(0, -1);
-            break;
-        case 's':
-        case 'S':
-            snake->setDirection(0, 1);
-            break;
-        case 'a':
-        case 'A':
-            snake->setDirection(-1, 0);
-            break;
-        case 'd':
-        case 'D':
-            snake->setDirection(1, 0);
-            break;
-        case 'q':
-        case 'Q':
-            gameOver = true;
-            break;
+            const uint64_t *pass = board.passableRow(y);
+            for (int k = 0; k < wordsPerRow; ++k)
+            {
+                uint64_t bits = pass[k] & ~reach[y * wordsPerRow + k];
+                while (bits)
+                {
+                    out.push_back(Point(k * 64 + __builtin_ctzll(bits), y));
+                    bits &= bits - 1;
+                }
+            }
         }
     }
 
-    bool checkCollision()
+    // Uniform pick among free reachable cells. Falls back to any free cell
+    // when nothing free is reachable or the map is stale, so spawning only
+    // fails on a genuinely full board.
+    bool pickFreeCell(const Board &board, Rng &rng, Point &out)
     {
-        Point head = snake->getHead();
+        if (!valid || board.getWidth() != width || board.getHeight() != height)
+            return board.randomFreeCell(rng, out);
 
-        // Wall collision (ignore if invincible)
-        if (head.x < 0 || head.x >= WIDTH || head.y < 0 || head.y >= HEIGHT)
+        if (deferred && originSealed)
+            return pickInPocket(board, rng, out);
+
+        // Most free cells are usually reachable: try cheap rejection sampling first
+        for (int attempt = 0; attempt < 8; ++attempt)
         {
-            if (!invincibilityActive)
-            {
-                SoundManager::playSound("collision");
+            if (!board.randomFreeCell(rng, out))
+                return false;
+            if (deferred ? escapes(board, out, origin, nullptr) : reachable(out))
                 return true;
-            }
         }
+        if (deferred)
+            compute(board, origin);
 
-        // Self collision (ignore if invincible)
-        if (snake->checkSelfCollision())
+        int total = 0;
+        for (int y = 0; y < height; ++y)
         {
-            if (!invincibilityActive)
-            {
-                SoundManager::playSound("collision");
-                return true;
-            }
+            const uint64_t *free = board.freeRow(y);
+            for (int k = 0; k < wordsPerRow; ++k)
+                total += __builtin_popcountll(free[k] & reach[y * wordsPerRow + k]);
         }
+        if (total == 0)
+            return board.randomFreeCell(rng, out);
 
-        // Obstacle collision (ignore if invincible)
-        if (obstacles.isObstacle(head))
+        int pick = rng.uniform(total);
+        for (int y = 0; y < height; ++y)
         {
-            if (!invincibilityActive)
+            const uint64_t *free = board.freeRow(y);
+            for (int k = 0; k < wordsPerRow; ++k)
             {
-                SoundManager::playSound("collision");
+                uint64_t bits = free[k] & reach[y * wordsPerRow + k];
+                int count = __builtin_popcountll(bits);
+                if (pick >= count)
+                {
+                    pick -= count;
+                    continue;
+                }
+                while (pick-- > 0)
+                    bits &= bits - 1;
+                out = Point(k * 64 + __builtin_ctzll(bits), y);
                 return true;
             }
         }
-
         return false;
     }
+};
 
-    void checkFood()
+// ============ PowerUp System ============
+enum PowerUpType
+{
+    SPEED_BOOST,   // Faster movement
+    SLOW_DOWN,     // Slower movement
+    SCORE_DOUBLE,  // Double points for limited time
+    INVINCIBILITY, // Can't die from obstacles/walls temporarily
+    SHRINK         // Remove last segment
+};
+
+class PowerUp
+{
+private:
+    Point position;
+    PowerUpType type;
+    bool active;
+
+public:
+    PowerUp() : position(0, 0), type(SPEED_BOOST), active(false) {}
+
+    // Restricted to cells reachable from the snake's head when a map is given
+    bool spawn(Board &board, Rng &rng, ReachabilityMap *reach = nullptr)
     {
-        if (foodManager.checkAndRemoveFood(snake->getHead()))
-        {
-            snake->grow();
-            int points = doubleScoreActive ? 2 : 1;
-            score += points;
-            SoundManager::playSound("eat");
+        if (!(reach ? reach->pickFreeCell(board, rng, position) : board.randomFreeCell(rng, position)))
+            return false;
+        board.set(position, CELL_POWERUP);
 
-            // Spawn new food to maintain count
-            foodManager.spawnFood(WIDTH, HEIGHT, snake->getBody(), obstacles, powerups);
-        }
+        // Randomly select powerup type
+        type = static_cast<PowerUpType>(rng.uniform(5));
+        active = true;
+        return true;
     }
 
-    void checkPowerUp()
-    {
-        Point head = snake->getHead();
-        for (auto &powerup : powerups)
-        {
-            if (powerup.isActive() && head == powerup.getPosition())
-            {
-                SoundManager::playSound("powerup");
-                applyPowerUp(powerup);
-                powerup.deactivate();
+    Point getPosition() const { return position; }
+    PowerUpType getType() const { return type; }
+    bool isActive() const { return active; }
 
-                // Spawn new powerup after some delay
-                break;
-            }
-        }
+    void deactivate(Board &board)
+    {
+        if (active)
+            board.clear(position, CELL_POWERUP);
+        active = false;
     }
 
-    void applyPowerUp(PowerUp &powerup)
+    char getSymbol() const
     {
-        switch (powerup.getType())
+        switch (type)
         {
         case SPEED_BOOST:
-            currentSpeed = baseSpeed * 2; // Faster
-            break;
+            return 'S';
         case SLOW_DOWN:
-            currentSpeed = baseSpeed / 2; // Slower
-            break;
+            return 'L';
         case SCORE_DOUBLE:
-            doubleScoreActive = true;
-            doubleScoreTimer = 100;
-            break;
+            return 'D';
         case INVINCIBILITY:
-            invincibilityActive = true;
-            invincibilityTimer = 100;
-            break;
+            return 'I';
         case SHRINK:
-            snake->shrink();
-            break;
+            return 'R';
+        default:
+            return 'P';
         }
     }
 
-    void updatePowerUpEffects()
+    string getName() const
     {
-        // Update invincibility
-        if (invincibilityActive)
+        switch (type)
         {
-            invincibilityTimer--;
-            if (invincibilityTimer <= 0)
-            {
-                invincibilityActive = false;
+        case SPEED_BOOST:
+            return "Speed Boost";
+        case SLOW_DOWN:
+            return "Slow Motion";
+        case SCORE_DOUBLE:
+            return "Double Score";
+        case INVINCIBILITY:
+            return "Invincibility";
+        case SHRINK:
+            return "Shrink";
+        default:
+            return "PowerUp";
+        }
+    }
+};
+
+// ============ Obstacle Class ============
+class Obstacle
+{
+private:
+    Board &board;
+    vector<Point> positions;
+
+public:
+    Obstacle(Board &board) : board(board) {}
+
+    void generateObstacles(Rng &rng, const Point &snakeStart)
+    {
+        positions.clear();
+        int numObstacles = (board.getWidth() * board.getHeight()) / 50;
+
+        for (int i = 0; i < numObstacles; ++i)
+        {
+            int x = rng.uniform(board.getWidth());
+            int y = rng.uniform(board.getHeight());
+            Point obs(x, y);
+
+            if (abs(x - snakeStart.x) > 3 && abs(y - snakeStart.y) > 3)
+            {
+                positions.push_back(obs);
+                board.set(obs, CELL_OBSTACLE);
+            }
+        }
+    }
+
+    // Same layout rule, but reject layouts that wall off part of the board from
+    // the snake. After a few failed attempts any sealed pockets are filled in.
+    void generateObstacles(Rng &rng, const Point &snakeStart, ReachabilityMap &reach)
+    {
+        const int maxAttempts = 4;
+        for (int attempt = 0; attempt < maxAttempts; ++attempt)
+        {
+            clearObstacles();
+            generateObstacles(rng, snakeStart);
+            reach.compute(board, snakeStart);
+            if (reach.coversAllPassable(board))
+                return;
+        }
+
+        vector<Point> pockets;
+        reach.unreachedCells(board, pockets);
+        for (size_t i = 0; i < pockets.size(); ++i)
+        {
+            positions.push_back(pockets[i]);
+            board.set(pockets[i], CELL_OBSTACLE);
+        }
+    }
+
+    // Put back a saved layout
+    void restore(const Point *saved, size_t count)
+    {
+        positions.assign(saved, saved + count);
+        for (size_t i = 0; i < count; ++i)
+            board.set(saved[i], CELL_OBSTACLE);
+    }
+
+    void clearObstacles()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+            board.clear(positions[i], CELL_OBSTACLE);
+        positions.clear();
+    }
+
+    bool isObstacle(const Point &p) const
+    {
+        return board.has(p, CELL_OBSTACLE);
+    }
+
+    const vector<Point> &getPositions() const
+    {
+        return positions;
+    }
+};
+
+// ============ Level Generation ============
+// Structured obstacle layouts for level packs. Every level keeps a clear
+// 7x7 box around the snake's start, and any pocket the start can't reach
+// is walled in, so all open cells are connected. Levels that end up far
+// denser than asked for, or too cramped to play, fail validation.
+enum LevelStyle
+{
+    LEVEL_CAVES, // Cellular-automaton caves
+    LEVEL_MAZE,  // Braided maze: a perfect maze thinned to the target density
+    LEVEL_ROOMS, // Rectangular rooms joined by corridors
+    LEVEL_STYLE_COUNT
+};
+
+static const char *const LEVEL_STYLE_NAMES[LEVEL_STYLE_COUNT] = {"caves", "maze", "rooms"};
+
+struct Level
+{
+    int width;
+    int height;
+    int style;
+    uint64_t seed; // Generator seed, kept so a level can be regenerated
+    vector<Point> walls;
+
+    // FNV-1a over the size and wall cells; never 0, which replays use for
+    // scattered obstacles
+    uint64_t fingerprint() const
+    {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](uint32_t v) {
+            for (int i = 0; i < 4; ++i)
+            {
+                h ^= (v >> (8 * i)) & 0xff;
+                h *= 1099511628211ULL;
+            }
+        };
+        mix(width);
+        mix(height);
+        for (const auto &p : walls)
+            mix(p.y * width + p.x);
+        return h ? h : 1;
+    }
+};
+
+class LevelGenerator
+{
+private:
+    int width;
+    int height;
+    double density;             // Target fraction of cells walled
+    vector<unsigned char> wall; // 1 per walled cell
+    Board board;
+    ReachabilityMap reach;
+
+    bool isWall(int x, int y) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && wall[y * width + x];
+    }
+
+    int wallCount() const { return count(wall.begin(), wall.end(), 1); }
+
+    // Random fill smoothed by the 4-5 rule: a cell is wall when at least five
+    // of the nine cells around it are. Off-board cells count as open.
+    void smooth(double fill, Rng &rng)
+    {
+        for (auto &cell : wall)
+            cell = rng.uniform(1000) < fill * 1000;
+
+        vector<unsigned char> next(wall.size());
+        for (int pass = 0; pass < 4; ++pass)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    int walls = 0;
+                    for (int dy = -1; dy <= 1; ++dy)
+                    {
+                        for (int dx = -1; dx <= 1; ++dx)
+                            walls += isWall(x + dx, y + dy);
+                    }
+                    next[y * width + x] = walls >= 5;
+                }
+            }
+            wall.swap(next);
+        }
+    }
+
+    // Smoothing erodes sparse fills to almost nothing, so bisect the initial
+    // fill until the smoothed cave lands near the target density
+    void caves(Rng &rng)
+    {
+        int target = (int)(density * width * height);
+        double lo = 0.3;
+        double hi = 0.6;
+        vector<unsigned char> best;
+        int bestError = width * height;
+        for (int step = 0; step < 6; ++step)
+        {
+            double fill = (lo + hi) / 2;
+            smooth(fill, rng);
+            int walls = wallCount();
+            if (abs(walls - target) < bestError)
+            {
+                bestError = abs(walls - target);
+                best = wall;
+            }
+            (walls < target ? lo : hi) = fill;
+        }
+        wall.swap(best);
+    }
+
+    // Depth-first backtracker over the even cells, then knock out random
+    // walls until the density is reached; removing walls never disconnects
+    void maze(Rng &rng)
+    {
+        fill(wall.begin(), wall.end(), 1);
+        int cellsX = (width + 1) / 2;
+        int cellsY = (height + 1) / 2;
+        vector<bool> visited(cellsX * cellsY, false);
+        vector<int> stack(1, (cellsY / 2) * cellsX + cellsX / 2);
+        visited[stack[0]] = true;
+        wall[(stack[0] / cellsX) * 2 * width + (stack[0] % cellsX) * 2] = 0;
+
+        static const int dirs[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+        while (!stack.empty())
+        {
+            int cell = stack.back();
+            int cx = cell % cellsX;
+            int cy = cell / cellsX;
+            int options[4];
+            int n = 0;
+            for (int d = 0; d < 4; ++d)
+            {
+                int nx = cx + dirs[d][0];
+                int ny = cy + dirs[d][1];
+                if (nx >= 0 && nx < cellsX && ny >= 0 && ny < cellsY && !visited[ny * cellsX + nx])
+                    options[n++] = d;
+            }
+            if (n == 0)
+            {
+                stack.pop_back();
+                continue;
+            }
+            int d = options[rng.uniform(n)];
+            int nx = cx + dirs[d][0];
+            int ny = cy + dirs[d][1];
+            wall[(cy * 2 + dirs[d][1]) * width + cx * 2 + dirs[d][0]] = 0;
+            wall[ny * 2 * width + nx * 2] = 0;
+            visited[ny * cellsX + nx] = true;
+            stack.push_back(ny * cellsX + nx);
+        }
+
+        vector<int> walls;
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (wall[i])
+                walls.push_back(i);
+        }
+        int keep = (int)(density * width * height);
+        for (int i = walls.size(); i > keep && i > 0; --i)
+        {
+            int pick = rng.uniform(i);
+            wall[walls[pick]] = 0;
+            walls[pick] = walls[i - 1];
+        }
+    }
+
+    void carve(int x0, int y0, int x1, int y1)
+    {
+        for (int y = max(0, min(y0, y1)); y <= min(height - 1, max(y0, y1)); ++y)
+        {
+            for (int x = max(0, min(x0, x1)); x <= min(width - 1, max(x0, x1)); ++x)
+                wall[y * width + x] = 0;
+        }
+    }
+
+    // Rooms are added until the density is reached, each joined to the
+    // previous one by an L-shaped corridor; the first is centred on the start
+    void rooms(Rng &rng)
+    {
+        fill(wall.begin(), wall.end(), 1);
+        int target = (int)(density * width * height);
+        int px = width / 2;
+        int py = height / 2;
+        carve(px - 4, py - 2, px + 4, py + 2);
+        for (int attempt = 0; attempt < 200 && wallCount() > target; ++attempt)
+        {
+            int w = 4 + rng.uniform(max(1, width / 4));
+            int h = 3 + rng.uniform(max(1, height / 4));
+            int x = rng.uniform(max(1, width - w));
+            int y = rng.uniform(max(1, height - h));
+            carve(x, y, x + w - 1, y + h - 1);
+
+            int cx = x + w / 2;
+            int cy = y + h / 2;
+            if (rng.uniform(2))
+            {
+                carve(px, py, cx, py);
+                carve(cx, py, cx, cy);
+            }
+            else
+            {
+                carve(px, py, px, cy);
+                carve(px, cy, cx, cy);
+            }
+            px = cx;
+            py = cy;
+        }
+    }
+
+public:
+    LevelGenerator(int width, int height, double density)
+        : width(width), height(height), density(density), wall(width * height) {}
+
+    // One level from `seed`; false when it fails validation and should be retried
+    bool generate(LevelStyle style, uint64_t seed, Level &out)
+    {
+        Rng rng(seed);
+        switch (style)
+        {
+        case LEVEL_CAVES:
+            caves(rng);
+            break;
+        case LEVEL_MAZE:
+            maze(rng);
+            break;
+        default:
+            rooms(rng);
+            break;
+        }
+
+        Point start(width / 2, height / 2);
+        carve(start.x - 3, start.y - 3, start.x + 3, start.y + 3);
+
+        // Wall in whatever the start can't reach
+        board.reset(width, height);
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (wall[i])
+                board.set(Point(i % width, i / width), CELL_OBSTACLE);
+        }
+        reach.compute(board, start);
+        vector<Point> pockets;
+        reach.unreachedCells(board, pockets);
+        for (const auto &p : pockets)
+            wall[p.y * width + p.x] = 1;
+
+        int walls = wallCount();
+        if (walls > (density + 0.1) * width * height || walls > width * height * 3 / 4)
+            return false;
+
+        out.width = width;
+        out.height = height;
+        out.style = style;
+        out.seed = seed;
+        out.walls.clear();
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (wall[i])
+                out.walls.push_back(Point(i % width, i / width));
+        }
+        return true;
+    }
+};
+
+// Level pack file: "SNKP" + version byte, varint level count, then per level
+// varint width, varint height, style byte, varint seed and the walls as one
+// bitmap row of (width + 7) / 8 bytes per board row.
+static const char LEVEL_PACK_MAGIC[4] = {'S', 'N', 'K', 'P'};
+static const unsigned char LEVEL_PACK_VERSION = 1;
+
+class LevelPack
+{
+private:
+    vector<Level> levels; // Sorted by size so pick() can binary search
+
+    static bool bySize(const Level &a, const Level &b)
+    {
+        return a.width != b.width ? a.width < b.width : a.height < b.height;
+    }
+
+    static void putVarint(string &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out += (char)(v | 0x80);
+            v >>= 7;
+        }
+        out += (char)v;
+    }
+
+    static bool getVarint(const string &in, size_t &pos, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+        {
+            unsigned char b = in[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    void add(const Level &level) { levels.push_back(level); }
+    size_t size() const { return levels.size(); }
+    bool empty() const { return levels.empty(); }
+    const Level &operator[](size_t i) const { return levels[i]; }
+
+    // Uniform pick among the levels made for this board size, nullptr if none
+    const Level *pick(int width, int height, Rng &rng) const
+    {
+        Level key;
+        key.width = width;
+        key.height = height;
+        auto range = equal_range(levels.begin(), levels.end(), key, bySize);
+        if (range.first == range.second)
+            return nullptr;
+        return &*(range.first + rng.uniform(range.second - range.first));
+    }
+
+    bool save(const string &path) const
+    {
+        string data(LEVEL_PACK_MAGIC, LEVEL_PACK_MAGIC + 4);
+        data += (char)LEVEL_PACK_VERSION;
+        putVarint(data, levels.size());
+        for (const auto &level : levels)
+        {
+            putVarint(data, level.width);
+            putVarint(data, level.height);
+            data += (char)level.style;
+            putVarint(data, level.seed);
+            size_t rowBytes = (level.width + 7) / 8;
+            size_t bitmap = data.size();
+            data.resize(bitmap + rowBytes * level.height, 0);
+            for (const auto &p : level.walls)
+                data[bitmap + p.y * rowBytes + p.x / 8] |= 1 << (p.x % 8);
+        }
+
+        string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+        close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const string &path)
+    {
+        ifstream file(path, ios::binary);
+        if (!file.is_open())
+            return false;
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (data.size() < 5 || !equal(LEVEL_PACK_MAGIC, LEVEL_PACK_MAGIC + 4, data.begin()) ||
+            (unsigned char)data[4] != LEVEL_PACK_VERSION)
+            return false;
+
+        size_t pos = 5;
+        uint64_t count;
+        if (!getVarint(data, pos, count))
+            return false;
+        levels.clear();
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            Level level;
+            uint64_t w, h, seed;
+            if (!getVarint(data, pos, w) || !getVarint(data, pos, h) || w < 5 || h < 5 || w > 8192 ||
+                h > 8192 || pos >= data.size())
+                return false;
+            level.style = (unsigned char)data[pos++];
+            size_t rowBytes = (w + 7) / 8;
+            if (!getVarint(data, pos, seed) || level.style >= LEVEL_STYLE_COUNT ||
+                data.size() - pos < rowBytes * h)
+                return false;
+            level.width = w;
+            level.height = h;
+            level.seed = seed;
+            for (int y = 0; y < level.height; ++y)
+            {
+                for (int x = 0; x < level.width; ++x)
+                {
+                    if ((data[pos + y * rowBytes + x / 8] >> (x % 8)) & 1)
+                        level.walls.push_back(Point(x, y));
+                }
+            }
+            pos += rowBytes * h;
+            levels.push_back(level);
+        }
+        stable_sort(levels.begin(), levels.end(), bySize);
+        return true;
+    }
+};
+
+// ============ Food Class (Multiple Foods Support) ============
+class FoodManager
+{
+private:
+    Board &board;
+    vector<Point> foodPositions;
+    size_t maxFoods;
+
+public:
+    FoodManager(Board &board, int max = 3) : board(board), maxFoods(max) {}
+
+    // Returns false when there is no free cell left to place food on
+    bool spawnFood(Rng &rng, ReachabilityMap *reach = nullptr)
+    {
+        if (foodPositions.size() >= maxFoods)
+            return true;
+
+        Point newFood;
+        if (!(reach ? reach->pickFreeCell(board, rng, newFood) : board.randomFreeCell(rng, newFood)))
+            return false;
+
+        board.set(newFood, CELL_FOOD);
+        foodPositions.push_back(newFood);
+        return true;
+    }
+
+    void initializeFoods(Rng &rng, ReachabilityMap *reach = nullptr)
+    {
+        foodPositions.clear();
+        for (size_t i = 0; i < maxFoods; ++i)
+        {
+            spawnFood(rng, reach);
+        }
+    }
+
+    void restore(const Point *saved, size_t count)
+    {
+        foodPositions.assign(saved, saved + count);
+        for (size_t i = 0; i < count; ++i)
+            board.set(saved[i], CELL_FOOD);
+    }
+
+    bool checkAndRemoveFood(const Point &position)
+    {
+        if (!board.has(position, CELL_FOOD))
+            return false;
+
+        for (auto it = foodPositions.begin(); it != foodPositions.end(); ++it)
+        {
+            if (*it == position)
+            {
+                foodPositions.erase(it);
+                break;
+            }
+        }
+        board.clear(position, CELL_FOOD);
+        return true;
+    }
+
+    const vector<Point> &getFoodPositions() const
+    {
+        return foodPositions;
+    }
+
+    bool isFoodAt(const Point &p) const
+    {
+        return board.has(p, CELL_FOOD);
+    }
+};
+
+// ============ Snake Body Ring Buffer ============
+// Contiguous power-of-two ring of segments, head first. Sized once for the
+// whole board so moving and growing never allocate.
+class SnakeBody
+{
+private:
+    vector<Point> ring;
+    size_t mask;
+    size_t head;  // Slot of the head segment
+    size_t count; // Number of segments
+
+public:
+    class const_iterator
+    {
+    private:
+        const SnakeBody *body;
+        size_t i;
+
+    public:
+        const_iterator(const SnakeBody *body, size_t i) : body(body), i(i) {}
+        const Point &operator*() const { return (*body)[i]; }
+        const_iterator &operator++()
+        {
+            ++i;
+            return *this;
+        }
+        bool operator!=(const const_iterator &other) const { return i != other.i; }
+    };
+
+    SnakeBody(size_t minCapacity) { reset(minCapacity); }
+
+    // Empty the body; the buffer is kept, so rounds on the same board don't allocate
+    void reset(size_t minCapacity)
+    {
+        size_t capacity = 4;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+        ring.resize(capacity);
+        mask = capacity - 1;
+        head = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return ring.size(); }
+    bool full() const { return count == ring.size(); }
+
+    // Double the capacity, unrolling the segments to start at slot 0
+    void expand()
+    {
+        vector<Point> bigger(ring.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+            bigger[i] = (*this)[i];
+        ring.swap(bigger);
+        mask = ring.size() - 1;
+        head = 0;
+    }
+
+    // Index 0 is the head, size() - 1 the tail
+    const Point &operator[](size_t i) const { return ring[(head + i) & mask]; }
+    const Point &front() const { return ring[head]; }
+    const Point &back() const { return ring[(head + count - 1) & mask]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    void pushFront(const Point &p)
+    {
+        head = (head - 1) & mask;
+        ring[head] = p;
+        count++;
+    }
+
+    void pushBack(const Point &p)
+    {
+        ring[(head + count) & mask] = p;
+        count++;
+    }
+
+    void popBack() { count--; }
+
+    // Replace the contents with segments[0..n), head first
+    void assign(const Point *segments, size_t n)
+    {
+        while (ring.size() < n)
+            ring.resize(ring.size() * 2);
+        mask = ring.size() - 1;
+        copy(segments, segments + n, ring.begin());
+        head = 0;
+        count = n;
+    }
+
+    // Write the segments head first into out, as at most two block copies
+    void copyTo(Point *out) const
+    {
+        size_t firstRun = min(count, ring.size() - head);
+        copy(ring.begin() + head, ring.begin() + head + firstRun, out);
+        copy(ring.begin(), ring.begin() + (count - firstRun), out + firstRun);
+    }
+
+    // Visit segments head to tail as at most two contiguous runs
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        size_t firstRun = min(count, ring.size() - head);
+        for (size_t i = 0; i < firstRun; ++i)
+            fn(ring[head + i]);
+        for (size_t i = 0; i < count - firstRun; ++i)
+            fn(ring[i]);
+    }
+};
+
+// ============ Snake Class ============
+class Snake
+{
+private:
+    Board &board;
+    SnakeBody body;
+    size_t maxLength; // Every cell of the board plus the starting segments
+    Point direction;
+    Point nextDirection;
+    bool growing;
+
+    void placeAt(int startX, int startY)
+    {
+        body.pushBack(Point(startX, startY));
+        body.pushBack(Point(startX - 1, startY));
+        body.pushBack(Point(startX - 2, startY));
+        body.forEach([this](const Point &segment) { board.addSnake(segment); });
+        board.addHead(body.front());
+    }
+
+public:
+    // Ordinary boards get their whole maximum length up front; huge ones (and
+    // server snakes) start at initialCapacity and double as the snake grows
+    Snake(Board &board, int startX, int startY, size_t initialCapacity = 1 << 16)
+        : board(board), body(min<size_t>((size_t)board.getWidth() * board.getHeight() + 3, initialCapacity)),
+          maxLength((size_t)board.getWidth() * board.getHeight() + 3),
+          direction(1, 0), nextDirection(1, 0), growing(false)
+    {
+        placeAt(startX, startY);
+    }
+
+    // Start over on the (freshly reset) board, reusing the body's buffer
+    void reset(int startX, int startY, size_t initialCapacity = 1 << 16)
+    {
+        maxLength = (size_t)board.getWidth() * board.getHeight() + 3;
+        body.reset(min(maxLength, initialCapacity));
+        direction = nextDirection = Point(1, 0);
+        growing = false;
+        placeAt(startX, startY);
+    }
+
+    // Rebuild a saved snake, segments head first
+    void restore(const Point *segments, size_t count, const Point &savedDirection, const Point &savedNextDirection,
+                 bool savedGrowing)
+    {
+        maxLength = (size_t)board.getWidth() * board.getHeight() + 3;
+        body.reset(min<size_t>(maxLength, 1 << 16));
+        body.assign(segments, count);
+        body.forEach([this](const Point &segment) { board.addSnake(segment); });
+        board.addHead(body.front());
+        direction = savedDirection;
+        nextDirection = savedNextDirection;
+        growing = savedGrowing;
+    }
+
+    // Returns false for reversals and for the direction already being travelled
+    bool setDirection(int dx, int dy)
+    {
+        if ((dx == -direction.x && dy == -direction.y) || (dx == direction.x && dy == direction.y))
+            return false;
+        nextDirection.x = dx;
+        nextDirection.y = dy;
+        return true;
+    }
+
+    void move()
+    {
+        direction = nextDirection;
+
+        Point newHead(body.front().x + direction.x, body.front().y + direction.y);
+
+        if (growing && body.full() && body.capacity() < maxLength)
+            body.expand();
+
+        // A full ring can't grow any further; the tail follows as usual
+        if (!growing || body.full())
+        {
+            board.removeSnake(body.back());
+            body.popBack();
+        }
+        growing = false;
+
+        board.removeHead(body.front());
+        body.pushFront(newHead);
+        board.addSnake(newHead);
+        board.addHead(newHead);
+    }
+
+    void grow()
+    {
+        growing = true;
+    }
+
+    void shrink()
+    {
+        if (body.size() > 3) // Keep minimum length
+        {
+            board.removeSnake(body.back());
+            body.popBack();
+        }
+    }
+
+    Point getHead() const
+    {
+        return body.front();
+    }
+
+    Point getDirection() const
+    {
+        return direction;
+    }
+
+    Point getNextDirection() const { return nextDirection; }
+    bool isGrowing() const { return growing; }
+
+    const SnakeBody &getBody() const
+    {
+        return body;
+    }
+
+    // Head shares its cell with another segment
+    bool checkSelfCollision() const
+    {
+        return board.snakeAt(body.front()) > 1;
+    }
+};
+
+// ============ Leaderboard ============
+// snake_scores.log: "SNKL" + version byte, then fixed 32-byte records, each
+// appended with O_APPEND and fsync'd before the game moves on:
+//   u32 score, u32 length, u32 duration ms, u32 checksum, u64 seed, i64 unix time
+// (little endian; the checksum is FNV-1a over the other 28 bytes).
+// snake_scores.idx holds the top LEADERBOARD_SIZE entries, the log's inode and
+// how many log bytes they cover. Writers replace it by atomic rename after every
+// append, so startup reads the index plus the log tail behind it (usually
+// empty) no matter how long the log has grown. Writers serialise on
+// flock(snake_scores.lock); readers never block.
+static const char SCORE_LOG_MAGIC[4] = {'S', 'N', 'K', 'L'};
+static const char SCORE_INDEX_MAGIC[4] = {'S', 'N', 'K', 'I'};
+static const unsigned char SCORE_FORMAT_VERSION = 1;
+static const size_t SCORE_HEADER_SIZE = 5;
+static const size_t SCORE_RECORD_SIZE = 32;
+static const size_t LEADERBOARD_SIZE = 10;
+
+struct ScoreEntry
+{
+    uint32_t score;
+    uint32_t length;
+    uint32_t durationMs;
+    uint64_t seed;
+    int64_t timestamp;
+
+    ScoreEntry() : score(0), length(0), durationMs(0), seed(0), timestamp(0) {}
+};
+
+class Leaderboard
+{
+private:
+    string logPath;
+    string indexPath;
+    string lockPath;
+    string legacyPath; // Single-integer high score file from older versions
+    vector<ScoreEntry> top; // Best first
+    uint64_t totalEntries;
+    uint64_t logInode;   // Identity of the log the index describes
+    uint64_t coveredSize; // Log bytes already folded into top
+    bool logDamaged;     // Torn tail or bad checksum seen; the next writer compacts
+    int previousBest;    // High score just before the last record(), read under the lock
+
+    static void put32(unsigned char *p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (unsigned char)(v >> (8 * i));
+    }
+
+    static void put64(unsigned char *p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = (unsigned char)(v >> (8 * i));
+    }
+
+    static uint32_t get32(const unsigned char *p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t)p[i] << (8 * i);
+        return v;
+    }
+
+    static uint64_t get64(const unsigned char *p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= (uint64_t)p[i] << (8 * i);
+        return v;
+    }
+
+    static uint32_t checksum(const unsigned char *record)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < SCORE_RECORD_SIZE; ++i)
+        {
+            if (i >= 12 && i < 16)
+                continue; // The checksum field itself
+            h = (h ^ record[i]) * 16777619u;
+        }
+        return h;
+    }
+
+    static void encode(const ScoreEntry &e, unsigned char *record)
+    {
+        put32(record, e.score);
+        put32(record + 4, e.length);
+        put32(record + 8, e.durationMs);
+        put64(record + 16, e.seed);
+        put64(record + 24, (uint64_t)e.timestamp);
+        put32(record + 12, checksum(record));
+    }
+
+    static bool decode(const unsigned char *record, ScoreEntry &e)
+    {
+        if (get32(record + 12) != checksum(record))
+            return false;
+        e.score = get32(record);
+        e.length = get32(record + 4);
+        e.durationMs = get32(record + 8);
+        e.seed = get64(record + 16);
+        e.timestamp = (int64_t)get64(record + 24);
+        return true;
+    }
+
+    // Higher score first; ties go to the earlier game
+    static bool better(const ScoreEntry &a, const ScoreEntry &b)
+    {
+        return a.score != b.score ? a.score > b.score : a.timestamp < b.timestamp;
+    }
+
+    void consider(const ScoreEntry &e)
+    {
+        totalEntries++;
+        if (top.size() == LEADERBOARD_SIZE && !better(e, top.back()))
+            return;
+        top.insert(upper_bound(top.begin(), top.end(), e, better), e);
+        if (top.size() > LEADERBOARD_SIZE)
+            top.pop_back();
+    }
+
+    static bool writeAll(int fd, const unsigned char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = write(fd, data, length);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Make a rename in the current directory durable
+    static void syncDirectory()
+    {
+        int fd = ::open(".", O_RDONLY | O_DIRECTORY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+    }
+
+    // Write to a temporary file, fsync it, then rename it over path
+    static bool replaceFile(const string &path, const vector<unsigned char> &data)
+    {
+        string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = writeAll(fd, data.data(), data.size()) && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            unlink(tmp.c_str());
+            return false;
+        }
+        syncDirectory();
+        return true;
+    }
+
+    bool readIndex()
+    {
+        ifstream file(indexPath, ios::binary);
+        vector<unsigned char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        size_t fixed = SCORE_HEADER_SIZE + 8 + 8 + 8 + 4;
+        if (data.size() < fixed || !equal(SCORE_INDEX_MAGIC, SCORE_INDEX_MAGIC + 4, data.begin()) ||
+            data[4] != SCORE_FORMAT_VERSION)
+            return false;
+
+        const unsigned char *p = data.data() + SCORE_HEADER_SIZE;
+        logInode = get64(p);
+        coveredSize = get64(p + 8);
+        totalEntries = get64(p + 16);
+        uint32_t count = get32(p + 24);
+        if (count > LEADERBOARD_SIZE || data.size() != fixed + count * SCORE_RECORD_SIZE)
+            return false;
+
+        top.clear();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ScoreEntry e;
+            if (!decode(data.data() + fixed + i * SCORE_RECORD_SIZE, e))
+                return false;
+            top.push_back(e);
+        }
+        return true;
+    }
+
+    bool writeIndex()
+    {
+        vector<unsigned char> data(SCORE_HEADER_SIZE + 28 + top.size() * SCORE_RECORD_SIZE);
+        copy(SCORE_INDEX_MAGIC, SCORE_INDEX_MAGIC + 4, data.begin());
+        data[4] = SCORE_FORMAT_VERSION;
+        unsigned char *p = data.data() + SCORE_HEADER_SIZE;
+        put64(p, logInode);
+        put64(p + 8, coveredSize);
+        put64(p + 16, totalEntries);
+        put32(p + 24, top.size());
+        for (size_t i = 0; i < top.size(); ++i)
+            encode(top[i], p + 28 + i * SCORE_RECORD_SIZE);
+        return replaceFile(indexPath, data);
+    }
+
+    // Fold log records from coveredSize onwards into top
+    void scanLog(int fd, uint64_t size)
+    {
+        if (coveredSize < SCORE_HEADER_SIZE)
+            coveredSize = SCORE_HEADER_SIZE;
+        if ((size - SCORE_HEADER_SIZE) % SCORE_RECORD_SIZE != 0)
+            logDamaged = true; // A crash mid-append left a partial record
+
+        vector<unsigned char> chunk(2048 * SCORE_RECORD_SIZE);
+        while (size - coveredSize >= SCORE_RECORD_SIZE)
+        {
+            size_t want = min<uint64_t>(chunk.size(), (size - coveredSize) / SCORE_RECORD_SIZE * SCORE_RECORD_SIZE);
+            ssize_t n = pread(fd, chunk.data(), want, coveredSize);
+            if (n < (ssize_t)SCORE_RECORD_SIZE)
+                break;
+            n -= n % SCORE_RECORD_SIZE;
+            for (ssize_t i = 0; i < n; i += SCORE_RECORD_SIZE)
+            {
+                ScoreEntry e;
+                if (decode(chunk.data() + i, e))
+                    consider(e);
+                else
+                    logDamaged = true;
+            }
+            coveredSize += n;
+        }
+    }
+
+    // Bring top up to date with the log; a stale or missing index means a full scan
+    void refresh()
+    {
+        logDamaged = false;
+        bool indexed = readIndex();
+
+        int fd = ::open(logPath.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        char magic[4];
+        bool valid = fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= (off_t)SCORE_HEADER_SIZE &&
+                     pread(fd, magic, 4, 0) == 4 && equal(magic, magic + 4, SCORE_LOG_MAGIC);
+        if (!valid)
+        {
+            // Missing, cut short while writing the header, or not ours at all
+            logDamaged = fd >= 0;
+            if (fd >= 0)
+                close(fd);
+            top.clear();
+            totalEntries = 0;
+            logInode = 0;
+            coveredSize = 0;
+            return;
+        }
+
+        if (!indexed || logInode != (uint64_t)st.st_ino || coveredSize > (uint64_t)st.st_size)
+        {
+            top.clear();
+            totalEntries = 0;
+            coveredSize = 0;
+        }
+        logInode = st.st_ino;
+        scanLog(fd, st.st_size);
+        close(fd);
+    }
+
+    // Rewrite the log without torn or corrupt records, then swap it in by rename
+    bool compact()
+    {
+        int fd = ::open(logPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        vector<unsigned char> data(SCORE_LOG_MAGIC, SCORE_LOG_MAGIC + 4);
+        data.push_back(SCORE_FORMAT_VERSION);
+
+        unsigned char record[SCORE_RECORD_SIZE];
+        ScoreEntry e;
+        for (off_t pos = SCORE_HEADER_SIZE; pread(fd, record, SCORE_RECORD_SIZE, pos) == (ssize_t)SCORE_RECORD_SIZE;
+             pos += SCORE_RECORD_SIZE)
+        {
+            if (decode(record, e))
+                data.insert(data.end(), record, record + SCORE_RECORD_SIZE);
+        }
+        close(fd);
+
+        if (!replaceFile(logPath, data))
+            return false;
+        refresh(); // New inode, so this rescans the compacted log in full
+        return true;
+    }
+
+    // The old file held one bare integer, carried over as a single entry
+    bool readLegacy(ScoreEntry &e) const
+    {
+        ifstream file(legacyPath);
+        int legacyScore = 0;
+        if (!(file >> legacyScore) || legacyScore <= 0)
+            return false;
+        e = ScoreEntry();
+        e.score = legacyScore;
+        return true;
+    }
+
+public:
+    Leaderboard(const string &basename = "snake_scores")
+        : logPath(basename + ".log"), indexPath(basename + ".idx"), lockPath(basename + ".lock"),
+          legacyPath("snake_highscore.dat"), totalEntries(0), logInode(0), coveredSize(0), logDamaged(false),
+          previousBest(0)
+    {
+        // Read-only until the first record(), which imports the legacy score
+        // for real; until then it is only shown
+        refresh();
+        ScoreEntry legacy;
+        if (logInode == 0 && readLegacy(legacy))
+            consider(legacy);
+    }
+
+    // Append one finished game; durable once this returns true
+    bool record(const ScoreEntry &entry)
+    {
+        previousBest = getHighScore();
+        int lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lockFd < 0)
+            return false;
+        while (flock(lockFd, LOCK_EX) != 0 && errno == EINTR)
+        {
+        }
+
+        // Other instances may have appended or compacted since we last looked
+        refresh();
+        if (logDamaged)
+            compact();
+
+        // The legacy score goes in under the lock and only into an empty log,
+        // so instances started together import it once
+        ScoreEntry pending[2];
+        size_t count = 0;
+        if (logInode == 0 && readLegacy(pending[count]))
+            count++;
+        pending[count++] = entry;
+        previousBest = max(getHighScore(), count > 1 ? (int)pending[0].score : 0);
+
+        bool ok = false;
+        int fd = ::open(logPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+        {
+            bool fresh = st.st_size < (off_t)SCORE_HEADER_SIZE;
+            if (fresh)
+            {
+                unsigned char header[SCORE_HEADER_SIZE] = {'S', 'N', 'K', 'L', SCORE_FORMAT_VERSION};
+                if (ftruncate(fd, 0) == 0)
+                    writeAll(fd, header, sizeof(header));
+                coveredSize = SCORE_HEADER_SIZE;
+            }
+            unsigned char buffer[2 * SCORE_RECORD_SIZE];
+            for (size_t i = 0; i < count; ++i)
+                encode(pending[i], buffer + i * SCORE_RECORD_SIZE);
+            ok = writeAll(fd, buffer, count * SCORE_RECORD_SIZE) && fsync(fd) == 0;
+            if (ok)
+            {
+                if (fresh)
+                    syncDirectory();
+                logInode = st.st_ino;
+                coveredSize += count * SCORE_RECORD_SIZE;
+                for (size_t i = 0; i < count; ++i)
+                    consider(pending[i]);
+                writeIndex();
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+
+        flock(lockFd, LOCK_UN);
+        close(lockFd);
+        return ok;
+    }
+
+    int getHighScore() const
+    {
+        return top.empty() ? 0 : top[0].score;
+    }
+
+    // Best score before the last record(), including games other instances
+    // appended in the meantime
+    int getPreviousBest() const { return previousBest; }
+
+    const vector<ScoreEntry> &getTop() const { return top; }
+    uint64_t getTotalGames() const { return totalEntries; }
+
+    void print(ostream &out, size_t count = LEADERBOARD_SIZE) const
+    {
+        for (size_t i = 0; i < top.size() && i < count; ++i)
+        {
+            const ScoreEntry &e = top[i];
+            char date[32] = "-";
+            time_t t = e.timestamp;
+            struct tm local;
+            if (e.timestamp > 0 && localtime_r(&t, &local))
+                strftime(date, sizeof(date), "%Y-%m-%d %H:%M", &local);
+            out << "  " << (i + 1) << ". " << e.score << "  (length " << e.length << ", "
+                << e.durationMs / 1000 << "s, " << date << ")" << endl;
+        }
+    }
+};
+
+// ============ Tick Profiler ============
+// Per-phase tick latency, recorded into log-linear histograms. Build with
+// -DSNAKE_PROFILE and run with --profile; without the define PROFILE_PHASE
+// expands to nothing, and with it but no --profile each phase costs one branch.
+// Profiling builds also count heap allocations per thread, so the phase table
+// shows any allocation that creeps back into the tick loop.
+#ifdef SNAKE_PROFILE
+static thread_local uint64_t allocationCount = 0;
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+// Out of line, or GCC sees free() paired with operator new and warns
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static uint64_t allocationsSoFar()
+{
+    return allocationCount;
+}
+#else
+static uint64_t allocationsSoFar()
+{
+    return 0;
+}
+#endif
+
+enum TickPhase
+{
+    PHASE_DRAW,
+    PHASE_INPUT,
+    PHASE_MOVE,
+    PHASE_COLLISION,
+    PHASE_FOOD,
+    PHASE_POWERUP,
+    PHASE_EFFECTS,
+    PHASE_SLEEP,
+    PHASE_TICK, // Whole tick excluding sleep
+    PHASE_COUNT
+};
+
+// 16 linear sub-buckets per power of two: values up to 2^63 ns with <= 6.25% error
+class LatencyHistogram
+{
+private:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKETS = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    uint64_t maxValue;
+
+    static int bucketFor(uint64_t v)
+    {
+        if (v < (uint64_t)SUB_COUNT)
+            return v;
+        int exponent = 63 - __builtin_clzll(v);
+        int sub = (v >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+        return SUB_COUNT + (exponent - SUB_BITS) * SUB_COUNT + sub;
+    }
+
+    static uint64_t bucketValue(int bucket)
+    {
+        if (bucket < SUB_COUNT)
+            return bucket;
+        int exponent = (bucket - SUB_COUNT) / SUB_COUNT + SUB_BITS;
+        int sub = (bucket - SUB_COUNT) % SUB_COUNT;
+        return ((uint64_t)(SUB_COUNT + sub)) << (exponent - SUB_BITS);
+    }
+
+public:
+    LatencyHistogram() { clear(); }
+
+    void clear()
+    {
+        fill(counts, counts + BUCKETS, 0);
+        total = 0;
+        maxValue = 0;
+    }
+
+    void record(uint64_t ns)
+    {
+        counts[bucketFor(ns)]++;
+        total++;
+        maxValue = max(maxValue, ns);
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t maxRecorded() const { return maxValue; }
+
+    // Lower bound of the bucket holding the given quantile
+    uint64_t percentile(double q) const
+    {
+        uint64_t rank = (uint64_t)(q * total);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen > rank)
+                return bucketValue(i);
+        }
+        return maxValue;
+    }
+};
+
+class TickProfiler
+{
+private:
+    LatencyHistogram phases[PHASE_COUNT];
+    uint64_t allocations[PHASE_COUNT];    // Heap allocations made inside each phase
+    uint64_t allocatingRuns[PHASE_COUNT]; // Phase runs that allocated at all
+
+public:
+    static uint64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    TickProfiler()
+    {
+        fill(allocations, allocations + PHASE_COUNT, 0);
+        fill(allocatingRuns, allocatingRuns + PHASE_COUNT, 0);
+    }
+
+    void record(TickPhase phase, uint64_t ns, uint64_t allocs)
+    {
+        phases[phase].record(ns);
+        allocations[phase] += allocs;
+        allocatingRuns[phase] += allocs != 0;
+    }
+
+    void dump(ostream &out) const
+    {
+        static const char *names[PHASE_COUNT] = {"draw", "getInput", "move", "checkCollision", "checkFood",
+                                                  "checkPowerUp", "runTimers", "sleep", "tick"};
+        out << "Phase                     count      p50 us      p99 us      max us    allocs  alloc runs" << endl;
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            const LatencyHistogram &h = phases[i];
+            if (h.count() == 0)
+                continue;
+            char line[160];
+            snprintf(line, sizeof(line), "%-20s %10llu %11.2f %11.2f %11.2f %9llu %11llu", names[i],
+                     (unsigned long long)h.count(), h.percentile(0.5) / 1000.0, h.percentile(0.99) / 1000.0,
+                     h.maxRecorded() / 1000.0, (unsigned long long)allocations[i],
+                     (unsigned long long)allocatingRuns[i]);
+            out << line << endl;
+        }
+    }
+};
+
+// Records the lifetime of a scope into the profiler's histogram for a phase
+class PhaseTimer
+{
+private:
+    TickProfiler *profiler;
+    TickPhase phase;
+    uint64_t start;
+    uint64_t startAllocations;
+
+public:
+    PhaseTimer(TickProfiler *profiler, TickPhase phase)
+        : profiler(profiler), phase(phase), start(profiler ? TickProfiler::now() : 0),
+          startAllocations(allocationsSoFar()) {}
+
+    ~PhaseTimer()
+    {
+        if (profiler)
+            profiler->record(phase, TickProfiler::now() - start, allocationsSoFar() - startAllocations);
+    }
+};
+
+#ifdef SNAKE_PROFILE
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_PHASE(profiler, phase) PhaseTimer PROFILE_CONCAT(phaseTimer, __LINE__)(profiler, phase)
+#else
+#define PROFILE_PHASE(profiler, phase)
+#endif
+
+#ifdef SNAKE_PROFILE
+// Set from SIGUSR1; the game loop dumps the histograms at the next tick
+static volatile sig_atomic_t profileDumpRequested = 0;
+
+static void requestProfileDump(int)
+{
+    profileDumpRequested = 1;
+}
+#endif
+
+// ============ Timer Wheel ============
+// Hierarchical timing wheel over game ticks: four levels of 64 slots cover
+// 2^24 ticks ahead. A timer waits on the coarsest level it differs from the
+// current tick on and drops a level each time its slot comes round, so a
+// tick only touches the timers expiring in it plus, every 64 ticks, one
+// slot's cascade. Slots are intrusive lists threaded through a node pool,
+// so scheduling allocates nothing once the pool has grown to the peak
+// number of pending timers.
+struct TimerEvent
+{
+    uint64_t due;
+    int kind;
+    uint32_t tag; // Owner-defined, e.g. a generation to recognise stale timers
+};
+
+class TimerWheel
+{
+private:
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int LEVELS = 4;
+
+    struct Node
+    {
+        TimerEvent event;
+        int next;
+    };
+
+    vector<Node> nodes;
+    int freeList;
+    int slots[LEVELS][SLOTS]; // First node of each slot's list, -1 when empty
+    uint64_t now;
+    size_t pending;
+
+    void place(int node)
+    {
+        uint64_t due = nodes[node].event.due;
+        int level = 0;
+        while (level < LEVELS - 1 && (due >> (SLOT_BITS * (level + 1))) != (now >> (SLOT_BITS * (level + 1))))
+            level++;
+        int &head = slots[level][(due >> (SLOT_BITS * level)) & (SLOTS - 1)];
+        nodes[node].next = head;
+        head = node;
+    }
+
+    int takeSlot(int level, int slot)
+    {
+        int list = slots[level][slot];
+        slots[level][slot] = -1;
+        return list;
+    }
+
+public:
+    TimerWheel() { reset(0); }
+
+    // Drop every timer and restart the clock at `start`; the pool is kept
+    void reset(uint64_t start)
+    {
+        freeList = -1;
+        for (int i = (int)nodes.size() - 1; i >= 0; --i)
+        {
+            nodes[i].next = freeList;
+            freeList = i;
+        }
+        for (int level = 0; level < LEVELS; ++level)
+            fill(slots[level], slots[level] + SLOTS, -1);
+        now = start;
+        pending = 0;
+    }
+
+    uint64_t getNow() const { return now; }
+    size_t size() const { return pending; }
+
+    void reserve(size_t timers) { nodes.reserve(timers); }
+
+    // Fire at tick `due`; anything not in the future fires on the next tick
+    void schedule(uint64_t due, int kind, uint32_t tag = 0)
+    {
+        int node = freeList;
+        if (node >= 0)
+            freeList = nodes[node].next;
+        else
+        {
+            node = nodes.size();
+            nodes.push_back(Node());
+        }
+        TimerEvent event = {max(due, now + 1), kind, tag};
+        nodes[node].event = event;
+        place(node);
+        pending++;
+    }
+
+    // Step the clock to `to`, calling fire(event) for each timer as its tick
+    // arrives; fire may schedule further timers
+    template <typename Fn>
+    void advance(uint64_t to, Fn fire)
+    {
+        while (now < to)
+        {
+            now++;
+
+            // Coarser slots that just came round move their timers down, outermost first
+            int level = 0;
+            while (level < LEVELS - 1 && (now & ((1ULL << (SLOT_BITS * (level + 1))) - 1)) == 0)
+                level++;
+            for (; level > 0; --level)
+            {
+                int node = takeSlot(level, (now >> (SLOT_BITS * level)) & (SLOTS - 1));
+                while (node >= 0)
+                {
+                    int next = nodes[node].next;
+                    place(node);
+                    node = next;
+                }
+            }
+
+            int node = takeSlot(0, now & (SLOTS - 1));
+            while (node >= 0)
+            {
+                int next = nodes[node].next;
+                TimerEvent event = nodes[node].event;
+                nodes[node].next = freeList;
+                freeList = node;
+                pending--;
+                fire(event);
+                node = next;
+            }
+        }
+    }
+};
+
+// ============ Game Engine (terminal-free logic) ============
+// Timed powerup effects; each expires through a TimerWheel event of the same kind
+enum EffectType
+{
+    EFFECT_INVINCIBLE,
+    EFFECT_DOUBLE_SCORE,
+    EFFECT_SPEED, // Speed boost or slow motion, whichever was picked up last
+    EFFECT_COUNT
+};
+
+// Wheel events besides effect expiry
+enum EngineTimer
+{
+    TIMER_SPAWN_POWERUP = EFFECT_COUNT
+};
+
+struct ActiveEffect
+{
+    bool active;
+    uint64_t expiresAt;  // Tick the expiry timer fires on
+    uint32_t generation; // Bumped on every restart; older expiry timers are stale
+};
+
+enum TickEvent
+{
+    EVENT_NONE = 0,
+    EVENT_EAT = 1,
+    EVENT_POWERUP = 2,
+    EVENT_COLLISION = 4,
+    EVENT_GAME_OVER = 8
+};
+
+// Snapshot file: this header, then the snake body (head first), foods and
+// obstacles as raw Point arrays, the powerups as raw PowerUp objects and
+// the board's free-cell list as int32 cell indices.
+// Native layout and byte order, so a snapshot is only meant for the build
+// that wrote it; the sizes recorded in the header catch mismatches.
+static const char SNAPSHOT_MAGIC[4] = {'S', 'N', 'K', 'S'};
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t powerUpSize;
+    int32_t width;
+    int32_t height;
+    uint64_t seed;
+    uint64_t rngState[4];
+    int32_t score;
+    int32_t baseSpeed;
+    int32_t currentSpeed;
+    int32_t tickCounter;
+    int32_t effectTicks[EFFECT_COUNT]; // Ticks left per EffectType, 0 when inactive
+    uint8_t gameOver;
+    uint8_t boardFull;
+    uint8_t growing;
+    uint8_t pendingTurnCount;
+    Point direction;
+    Point nextDirection;
+    Point pendingTurns[4];
+    uint32_t bodyCount;
+    uint32_t foodCount;
+    uint32_t obstacleCount;
+    uint32_t powerUpCount;
+    uint32_t freeCount;
+};
+
+static_assert(is_trivially_copyable<PowerUp>::value, "snapshots copy PowerUp objects as raw bytes");
+
+class Engine
+{
+private:
+    int WIDTH;
+    int HEIGHT;
+    Board board;
+    Rng rng;
+    uint64_t gameSeed;
+    Snake *snake;
+    FoodManager foodManager;
+    Obstacle obstacles;
+    ReachabilityMap reachability; // Cells the head can reach, refreshed before each spawn
+    vector<PowerUp> powerups;
+    int score;
+    int baseSpeed;
+    int currentSpeed;
+    bool gameOver;
+    bool boardFull; // Won by filling every free cell
+    int tickCounter;
+    int events;        // TickEvent bits raised during the current step
+    bool trackChanges; // Let the board record each tick's touched cells
+    TickProfiler *profiler; // nullptr unless --profile
+    const LevelPack *levels; // Layouts to play instead of random obstacles, nullptr for none
+    uint64_t levelFingerprint; // Of this round's pack level, 0 for scattered obstacles
+
+    // Turns typed faster than the tick rate, applied one per tick
+    static const int MAX_PENDING_TURNS = 4;
+    Point pendingTurns[MAX_PENDING_TURNS];
+    int pendingTurnCount;
+
+    // Powerups live in slots reserved up front; past the limit the oldest is dropped
+    static const size_t MAX_POWERUPS = 3;
+
+    // Timed effects and spawns, keyed on tickCounter
+    static const int EFFECT_TICKS = 100;
+    static const int POWERUP_SPAWN_TICKS = 150;
+    TimerWheel timers;
+    ActiveEffect effects[EFFECT_COUNT];
+
+    // Apply the first buffered turn the snake accepts; at most one per tick
+    void applyPendingTurn()
+    {
+        int used = 0;
+        bool turned = false;
+        while (used < pendingTurnCount && !turned)
+        {
+            turned = snake->setDirection(pendingTurns[used].x, pendingTurns[used].y);
+            used++;
+        }
+        for (int i = used; i < pendingTurnCount; ++i)
+            pendingTurns[i - used] = pendingTurns[i];
+        pendingTurnCount -= used;
+    }
+
+    bool checkCollision()
+    {
+        Point head = snake->getHead();
+
+        // Wall collision (ignore if invincible)
+        if (head.x < 0 || head.x >= WIDTH || head.y < 0 || head.y >= HEIGHT)
+        {
+            if (!effects[EFFECT_INVINCIBLE].active)
+            {
+                events |= EVENT_COLLISION;
+                return true;
+            }
+        }
+
+        // Self collision (ignore if invincible)
+        if (snake->checkSelfCollision())
+        {
+            if (!effects[EFFECT_INVINCIBLE].active)
+            {
+                events |= EVENT_COLLISION;
+                return true;
+            }
+        }
+
+        // Obstacle collision (ignore if invincible)
+        if (obstacles.isObstacle(head))
+        {
+            if (!effects[EFFECT_INVINCIBLE].active)
+            {
+                events |= EVENT_COLLISION;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void checkFood()
+    {
+        if (foodManager.checkAndRemoveFood(snake->getHead()))
+        {
+            snake->grow();
+            int points = effects[EFFECT_DOUBLE_SCORE].active ? 2 : 1;
+            score += points;
+            events |= EVENT_EAT;
+
+            // Spawn new food to maintain count; nothing left to eat means the board is won
+            reachability.prepare(board, snake->getHead());
+            if (!foodManager.spawnFood(rng, &reachability) && foodManager.getFoodPositions().empty())
+            {
+                boardFull = true;
+                gameOver = true;
+            }
+        }
+    }
+
+    void checkPowerUp()
+    {
+        Point head = snake->getHead();
+        if (!board.has(head, CELL_POWERUP))
+            return;
+
+        for (auto &powerup : powerups)
+        {
+            if (powerup.isActive() && head == powerup.getPosition())
+            {
+                events |= EVENT_POWERUP;
+                applyPowerUp(powerup);
+                powerup.deactivate(board);
+
+                // Spawn new powerup after some delay
+                break;
+            }
+        }
+    }
+
+    void applyPowerUp(PowerUp &powerup)
+    {
+        switch (powerup.getType())
+        {
+        case SPEED_BOOST:
+            currentSpeed = baseSpeed * 2; // Faster
+            startEffect(EFFECT_SPEED, EFFECT_TICKS, false);
+            break;
+        case SLOW_DOWN:
+            currentSpeed = baseSpeed / 2; // Slower
+            startEffect(EFFECT_SPEED, EFFECT_TICKS, false);
+            break;
+        case SCORE_DOUBLE:
+            startEffect(EFFECT_DOUBLE_SCORE, EFFECT_TICKS, true);
+            break;
+        case INVINCIBILITY:
+            startEffect(EFFECT_INVINCIBLE, EFFECT_TICKS, true);
+            break;
+        case SHRINK:
+            snake->shrink();
+            break;
+        }
+    }
+
+    // Run for `ticks` more ticks; stacking effects add to whatever time is left
+    void startEffect(EffectType type, int ticks, bool stack)
+    {
+        ActiveEffect &effect = effects[type];
+        uint64_t from = effect.active && stack ? effect.expiresAt : (uint64_t)tickCounter;
+        effect.active = true;
+        effect.expiresAt = from + ticks;
+        effect.generation++;
+        timers.schedule(effect.expiresAt, type, effect.generation);
+    }
+
+    void clearEffects()
+    {
+        for (int i = 0; i < EFFECT_COUNT; ++i)
+        {
+            effects[i].active = false;
+            effects[i].expiresAt = 0;
+            effects[i].generation = 0;
+        }
+    }
+
+    void spawnPowerUp()
+    {
+        reachability.prepare(board, snake->getHead());
+        PowerUp pu;
+        if (pu.spawn(board, rng, &reachability))
+            powerups.push_back(pu);
+
+        if (powerups.size() > MAX_POWERUPS)
+        {
+            powerups.front().deactivate(board);
+            powerups.erase(powerups.begin());
+        }
+    }
+
+    void fireTimer(const TimerEvent &timer)
+    {
+        if (timer.kind == TIMER_SPAWN_POWERUP)
+        {
+            spawnPowerUp();
+            timers.schedule(timer.due + POWERUP_SPAWN_TICKS, TIMER_SPAWN_POWERUP);
+            return;
+        }
+
+        ActiveEffect &effect = effects[timer.kind];
+        if (!effect.active || timer.tag != effect.generation)
+            return;
+        effect.active = false;
+        if (timer.kind == EFFECT_SPEED)
+            currentSpeed = baseSpeed;
+    }
+
+    // Advance the clock; only effects expiring and spawns due this tick cost anything
+    void runTimers()
+    {
+        tickCounter++;
+        timers.advance(tickCounter, [this](const TimerEvent &timer) { fireTimer(timer); });
+    }
+
+public:
+    Engine() : WIDTH(40), HEIGHT(25), gameSeed(1), snake(nullptr), foodManager(board, 3), obstacles(board), score(0),
+               baseSpeed(120000), currentSpeed(120000), gameOver(false), boardFull(false),
+               tickCounter(0), events(EVENT_NONE), trackChanges(false), profiler(nullptr), levels(nullptr),
+               levelFingerprint(0),
+               pendingTurnCount(0)
+    {
+        clearEffects();
+        // One slot over the limit: a new powerup lands before the oldest is dropped
+        powerups.reserve(MAX_POWERUPS + 1);
+        // The spawn timer plus a few live or stale expiries per effect
+        timers.reserve(1 + 4 * EFFECT_COUNT);
+    }
+
+    ~Engine()
+    {
+        if (snake)
+            delete snake;
+    }
+
+    // Same seed and same inputs replay the same game
+    void seed(uint64_t s)
+    {
+        gameSeed = s;
+        rng.reseed(s);
+    }
+
+    void setProfiler(TickProfiler *p) { profiler = p; }
+
+    // Each round plays a random pack level made for the board's size, if there is one
+    void setLevelPack(const LevelPack *pack) { levels = pack; }
+
+    // Renderers that redraw incrementally read getBoard().getChanges() after each step
+    void setChangeTracking(bool enabled)
+    {
+        trackChanges = enabled;
+        board.setChangeTracking(enabled);
+    }
+
+    // Start a fresh round on a gridWidth x gridHeight board
+    void reset(int gridWidth, int gridHeight)
+    {
+        WIDTH = gridWidth;
+        HEIGHT = gridHeight;
+
+        board.reset(WIDTH, HEIGHT);
+        if (snake)
+            snake->reset(WIDTH / 2, HEIGHT / 2);
+        else
+            snake = new Snake(board, WIDTH / 2, HEIGHT / 2);
+        score = 0;
+        gameOver = false;
+        boardFull = false;
+        tickCounter = 0;
+        pendingTurnCount = 0;
+        currentSpeed = baseSpeed;
+        clearEffects();
+        timers.reset(0);
+        timers.schedule(POWERUP_SPAWN_TICKS, TIMER_SPAWN_POWERUP);
+        powerups.clear();
+
+        const Level *level = levels ? levels->pick(WIDTH, HEIGHT, rng) : nullptr;
+        levelFingerprint = level ? level->fingerprint() : 0;
+        if (level)
+            obstacles.restore(level->walls.data(), level->walls.size());
+        else
+            obstacles.generateObstacles(rng, Point(WIDTH / 2, HEIGHT / 2), reachability);
+        reachability.compute(board, snake->getHead());
+        foodManager.initializeFoods(rng, &reachability);
+
+        // Spawn initial powerups
+        for (int i = 0; i < 2; ++i)
+        {
+            PowerUp pu;
+            if (pu.spawn(board, rng, &reachability))
+                powerups.push_back(pu);
+        }
+        board.setChangeTracking(trackChanges);
+    }
+
+    // Whole game state in one buffer, written with a single write() and
+    // renamed into place
+    bool saveSnapshot(const string &path) const
+    {
+        const SnakeBody &body = snake->getBody();
+        const vector<Point> &foods = foodManager.getFoodPositions();
+        const vector<Point> &walls = obstacles.getPositions();
+
+        SnapshotHeader h = SnapshotHeader();
+        copy(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4, h.magic);
+        h.version = SNAPSHOT_VERSION;
+        h.headerSize = sizeof(SnapshotHeader);
+        h.powerUpSize = sizeof(PowerUp);
+        h.width = WIDTH;
+        h.height = HEIGHT;
+        h.seed = gameSeed;
+        rng.getState(h.rngState);
+        h.score = score;
+        h.baseSpeed = baseSpeed;
+        h.currentSpeed = currentSpeed;
+        h.tickCounter = tickCounter;
+        for (int i = 0; i < EFFECT_COUNT; ++i)
+            h.effectTicks[i] = getEffectTicksLeft((EffectType)i);
+        h.gameOver = gameOver;
+        h.boardFull = boardFull;
+        h.growing = snake->isGrowing();
+        h.pendingTurnCount = pendingTurnCount;
+        h.direction = snake->getDirection();
+        h.nextDirection = snake->getNextDirection();
+        copy(pendingTurns, pendingTurns + pendingTurnCount, h.pendingTurns);
+        h.bodyCount = body.size();
+        h.foodCount = foods.size();
+        h.obstacleCount = walls.size();
+        h.powerUpCount = powerups.size();
+        h.freeCount = board.freeCount();
+
+        size_t size = sizeof(h) + (h.bodyCount + h.foodCount + h.obstacleCount) * sizeof(Point) +
+                      h.powerUpCount * sizeof(PowerUp) + h.freeCount * sizeof(int);
+        vector<char> data(size);
+        char *p = data.data();
+        memcpy(p, &h, sizeof(h));
+        p += sizeof(h);
+        body.copyTo((Point *)p);
+        p += h.bodyCount * sizeof(Point);
+        memcpy(p, foods.data(), h.foodCount * sizeof(Point));
+        p += h.foodCount * sizeof(Point);
+        memcpy(p, walls.data(), h.obstacleCount * sizeof(Point));
+        p += h.obstacleCount * sizeof(Point);
+        memcpy(p, powerups.data(), h.powerUpCount * sizeof(PowerUp));
+        p += h.powerUpCount * sizeof(PowerUp);
+        memcpy(p, board.freeCellOrder(), h.freeCount * sizeof(int));
+
+        string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = write(fd, data.data(), size) == (ssize_t)size;
+        close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Restore a saveSnapshot() file with one read(); the arrays are copied
+    // straight into the game structures and the board is rebuilt from them
+    bool loadSnapshot(const string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
+        {
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+        vector<char> data(st.st_size);
+        bool complete = read(fd, data.data(), data.size()) == (ssize_t)data.size();
+        close(fd);
+
+        SnapshotHeader h;
+        memcpy(&h, data.data(), sizeof(h));
+        size_t points = (size_t)h.bodyCount + h.foodCount + h.obstacleCount;
+        if (!complete || !equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4, h.magic) || h.version != SNAPSHOT_VERSION ||
+            h.headerSize != sizeof(SnapshotHeader) || h.powerUpSize != sizeof(PowerUp) || h.width < 5 ||
+            h.height < 5 || h.width > 8192 || h.height > 8192 || h.bodyCount == 0 || h.pendingTurnCount > 4 ||
+            data.size() != sizeof(h) + points * sizeof(Point) + (size_t)h.powerUpCount * sizeof(PowerUp) +
+                               (size_t)h.freeCount * sizeof(int))
+            return false;
+
+        const char *p = data.data() + sizeof(h);
+        const Point *body = (const Point *)p;
+        const Point *foods = body + h.bodyCount;
+        const Point *walls = foods + h.foodCount;
+        const char *saved = (const char *)(walls + h.obstacleCount);
+        vector<int> freeOrder(h.freeCount);
+        memcpy(freeOrder.data(), saved + h.powerUpCount * sizeof(PowerUp), h.freeCount * sizeof(int));
+
+        WIDTH = h.width;
+        HEIGHT = h.height;
+        gameSeed = h.seed;
+        rng.setState(h.rngState);
+        if (!snake)
+            snake = new Snake(board, 0, 0);
+        board.reset(WIDTH, HEIGHT);
+        snake->restore(body, h.bodyCount, h.direction, h.nextDirection, h.growing);
+        foodManager.restore(foods, h.foodCount);
+        obstacles.restore(walls, h.obstacleCount);
+        powerups.resize(h.powerUpCount);
+        memcpy(powerups.data(), saved, h.powerUpCount * sizeof(PowerUp));
+        for (const auto &pu : powerups)
+        {
+            if (pu.isActive())
+                board.set(pu.getPosition(), CELL_POWERUP);
+        }
+        if (!board.restoreFreeCellOrder(freeOrder.data(), freeOrder.size()))
+        {
+            reset(WIDTH, HEIGHT);
+            return false;
+        }
+
+        score = h.score;
+        baseSpeed = h.baseSpeed;
+        currentSpeed = h.currentSpeed;
+        tickCounter = h.tickCounter;
+        gameOver = h.gameOver;
+        boardFull = h.boardFull;
+
+        // The wheel isn't saved: re-arm the effects and the next periodic spawn
+        clearEffects();
+        timers.reset(tickCounter);
+        for (int i = 0; i < EFFECT_COUNT; ++i)
+        {
+            if (h.effectTicks[i] > 0)
+                startEffect((EffectType)i, h.effectTicks[i], false);
+        }
+        timers.schedule((tickCounter / POWERUP_SPAWN_TICKS + 1) * (uint64_t)POWERUP_SPAWN_TICKS, TIMER_SPAWN_POWERUP);
+        pendingTurnCount = h.pendingTurnCount;
+        copy(h.pendingTurns, h.pendingTurns + pendingTurnCount, pendingTurns);
+        board.setChangeTracking(trackChanges);
+        return true;
+    }
+
+    // Buffer a key for the coming ticks; returns false if it has no effect
+    bool queueInput(char input)
+    {
+        Point turn;
+        switch (input)
+        {
+        case 'w':
+        case 'W':
+            turn = Point(0, -1);
+            break;
+        case 's':
+        case 'S':
+            turn = Point(0, 1);
+            break;
+        case 'a':
+        case 'A':
+            turn = Point(-1, 0);
+            break;
+        case 'd':
+        case 'D':
+            turn = Point(1, 0);
+            break;
+        case 'q':
+        case 'Q':
+            gameOver = true;
+            return true;
+        default:
+            return false;
+        }
+
+        if (pendingTurnCount == MAX_PENDING_TURNS)
+            return false;
+        pendingTurns[pendingTurnCount++] = turn;
+        return true;
+    }
+
+    // Advance one tick with the given key (0 for none); returns TickEvent bits
+    int step(char input)
+    {
+        events = EVENT_NONE;
+        board.clearChanges();
+
+        if (input != 0)
+        {
+            queueInput(input);
+        }
+        applyPendingTurn();
+
+        {
+            PROFILE_PHASE(profiler, PHASE_MOVE);
+            snake->move();
+        }
+
+        {
+            PROFILE_PHASE(profiler, PHASE_COLLISION);
+            if (checkCollision())
+            {
+                gameOver = true;
+            }
+        }
+
+        {
+            PROFILE_PHASE(profiler, PHASE_FOOD);
+            checkFood();
+        }
+        {
+            PROFILE_PHASE(profiler, PHASE_POWERUP);
+            checkPowerUp();
+        }
+        {
+            PROFILE_PHASE(profiler, PHASE_EFFECTS);
+            runTimers();
+        }
+
+        if (gameOver)
+            events |= EVENT_GAME_OVER;
+        return events;
+    }
+
+    int getWidth() const { return WIDTH; }
+    int getHeight() const { return HEIGHT; }
+    uint64_t getSeed() const { return gameSeed; }
+    uint64_t getLevelFingerprint() const { return levelFingerprint; }
+    const Board &getBoard() const { return board; }
+    const Snake &getSnake() const { return *snake; }
+    const FoodManager &getFoodManager() const { return foodManager; }
+    const Obstacle &getObstacles() const { return obstacles; }
+    const vector<PowerUp> &getPowerUps() const { return powerups; }
+    int getScore() const { return score; }
+    int getLength() const { return snake->getBody().size(); }
+    int getSpeed() const { return currentSpeed; }
+    bool isGameOver() const { return gameOver; }
+    bool isBoardFull() const { return boardFull; }
+    bool isInvincible() const { return effects[EFFECT_INVINCIBLE].active; }
+    bool isDoubleScore() const { return effects[EFFECT_DOUBLE_SCORE].active; }
+    int getEffectTicksLeft(EffectType type) const
+    {
+        return effects[type].active ? effects[type].expiresAt - tickCounter : 0;
+    }
+    int getInvincibilityTimer() const { return getEffectTicksLeft(EFFECT_INVINCIBLE); }
+    int getDoubleScoreTimer() const { return getEffectTicksLeft(EFFECT_DOUBLE_SCORE); }
+};
+
+// ============ Autopilot ============
+// Plays the game by breadth-first search from the head to the nearest food
+// over the flat board grid. Buffers are sized once per board and stamped per
+// search instead of cleared, so a search only costs the cells it visits. The
+// path found stays valid until its food is gone (the body only ever trails
+// behind the head), so the search reruns once per food rather than per tick.
+class Autopilot
+{
+private:
+    int width;
+    int height;
+    vector<unsigned int> visited; // Search stamp per cell
+    vector<int> parent;           // Cell the search reached each cell from
+    vector<int> queue;
+    unsigned int stamp;
+
+    vector<int> path; // Cells from the head to the target food, head excluded
+    size_t pathPos;   // Next cell of path to step onto
+
+    static const Point &direction(int d)
+    {
+        static const Point directions[4] = {Point(0, -1), Point(0, 1), Point(-1, 0), Point(1, 0)};
+        return directions[d];
+    }
+
+    static char keyFor(int d)
+    {
+        static const char keys[4] = {'w', 's', 'a', 'd'};
+        return keys[d];
+    }
+
+    static bool isOpen(const Board &board, const Point &p)
+    {
+        return board.inBounds(p) && !board.has(p, CELL_OBSTACLE) && board.snakeAt(p) == 0;
+    }
+
+    static bool isReverse(const Point &dir, const Point &heading)
+    {
+        return dir.x == -heading.x && dir.y == -heading.y;
+    }
+
+    char keyTowards(const Point &head, int cell) const
+    {
+        int dx = cell % width - head.x;
+        int dy = cell / width - head.y;
+        for (int d = 0; d < 4; ++d)
+        {
+            if (direction(d).x == dx && direction(d).y == dy)
+                return keyFor(d);
+        }
+        return 0;
+    }
+
+    // Fallback when no food is reachable: the open move with the most open neighbours
+    char bestOpenMove(const Board &board, const Point &head, const Point &heading) const
+    {
+        int best = -1;
+        int bestScore = -1;
+        for (int d = 0; d < 4; ++d)
+        {
+            const Point &dir = direction(d);
+            Point next(head.x + dir.x, head.y + dir.y);
+            if (isReverse(dir, heading) || !isOpen(board, next))
+                continue;
+
+            int score = 0;
+            for (int e = 0; e < 4; ++e)
+                score += isOpen(board, Point(next.x + direction(e).x, next.y + direction(e).y));
+            if (score > bestScore)
+            {
+                best = d;
+                bestScore = score;
+            }
+        }
+        return best < 0 ? 0 : keyFor(best);
+    }
+
+    // BFS to the nearest food; fills path and returns false if none is reachable
+    bool search(const Board &board, const Point &head, const Point &heading)
+    {
+        if (++stamp == 0)
+        {
+            fill(visited.begin(), visited.end(), 0);
+            stamp = 1;
+        }
+
+        int start = head.y * width + head.x;
+        int queueHead = 0;
+        int queueTail = 0;
+        visited[start] = stamp;
+
+        int found = -1;
+        for (int d = 0; d < 4 && found < 0; ++d)
+        {
+            const Point &dir = direction(d);
+            Point next(head.x + dir.x, head.y + dir.y);
+            if (isReverse(dir, heading) || !isOpen(board, next))
+                continue;
+
+            int n = next.y * width + next.x;
+            visited[n] = stamp;
+            parent[n] = start;
+            queue[queueTail++] = n;
+            if (board.has(next, CELL_FOOD))
+                found = n;
+        }
+
+        while (queueHead < queueTail && found < 0)
+        {
+            int i = queue[queueHead++];
+            Point p(i % width, i / width);
+            for (int d = 0; d < 4; ++d)
+            {
+                Point next(p.x + direction(d).x, p.y + direction(d).y);
+                if (!isOpen(board, next))
+                    continue;
+                int n = next.y * width + next.x;
+                if (visited[n] == stamp)
+                    continue;
+
+                visited[n] = stamp;
+                parent[n] = i;
+                queue[queueTail++] = n;
+                if (board.has(next, CELL_FOOD))
+                {
+                    found = n;
+                    break;
+                }
+            }
+        }
+
+        path.clear();
+        pathPos = 0;
+        if (found < 0)
+            return false;
+        for (int i = found; i != start; i = parent[i])
+            path.push_back(i);
+        reverse(path.begin(), path.end());
+        return true;
+    }
+
+public:
+    Autopilot() : width(0), height(0), stamp(0), pathPos(0) {}
+
+    // Key to press this tick, 0 to keep going straight
+    char chooseKey(const Engine &engine)
+    {
+        const Board &board = engine.getBoard();
+        if (board.getWidth() != width || board.getHeight() != height)
+        {
+            width = board.getWidth();
+            height = board.getHeight();
+            visited.assign(width * height, 0);
+            parent.resize(width * height);
+            queue.resize(width * height);
+            path.clear();
+            path.reserve(width * height);
+            pathPos = 0;
+            stamp = 0;
+        }
+
+        Point head = engine.getSnake().getHead();
+        Point heading = engine.getSnake().getDirection();
+        if (!board.inBounds(head))
+            return 0;
+
+        // Follow the cached path while the head is on it and its food is still there
+        int headCell = head.y * width + head.x;
+        bool onPath = pathPos < path.size() && (pathPos == 0 ? false : path[pathPos - 1] == headCell);
+        if (!onPath || !board.has(Point(path.back() % width, path.back() / width), CELL_FOOD))
+        {
+            if (!search(board, head, heading))
+                return bestOpenMove(board, head, heading);
+        }
+
+        return keyTowards(head, path[pathPos++]);
+    }
+};
+
+// ============ Replay Recording ============
+// Replay file: "SNKR" + version byte, then per game:
+//   varint seed, varint width, varint height,
+//   varint level fingerprint (0 for scattered obstacles),
+//   { varint ticks since previous event, key byte } for every tick with input,
+//   closed by a zero key whose delta lands on the game's final tick.
+static const char REPLAY_MAGIC[4] = {'S', 'N', 'K', 'R'};
+static const unsigned char REPLAY_VERSION = 2;
+
+class ReplayWriter
+{
+private:
+    int fd;
+    unsigned char buffer[65536];
+    size_t used;
+    long long lastEventTick;
+
+    void flush()
+    {
+        size_t done = 0;
+        while (fd >= 0 && done < used)
+        {
+            ssize_t n = write(fd, buffer + done, used - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        used = 0;
+    }
+
+    void putByte(unsigned char b)
+    {
+        if (used == sizeof(buffer))
+            flush();
+        buffer[used++] = b;
+    }
+
+    void putVarint(uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            putByte((unsigned char)(v | 0x80));
+            v >>= 7;
+        }
+        putByte((unsigned char)v);
+    }
+
+public:
+    ReplayWriter() : fd(-1), used(0), lastEventTick(0) {}
+
+    ~ReplayWriter()
+    {
+        flush();
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool open(const string &path)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        for (char c : REPLAY_MAGIC)
+            putByte(c);
+        putByte(REPLAY_VERSION);
+        return true;
+    }
+
+    void beginGame(uint64_t seed, int width, int height, uint64_t level)
+    {
+        putVarint(seed);
+        putVarint(width);
+        putVarint(height);
+        putVarint(level);
+        lastEventTick = 0;
+    }
+
+    void recordInput(long long tick, char key)
+    {
+        putVarint(tick - lastEventTick);
+        putByte(key);
+        lastEventTick = tick;
+    }
+
+    // Flushes at every game boundary so a crash loses at most the current game
+    void endGame(long long ticks)
+    {
+        putVarint(ticks - lastEventTick);
+        putByte(0);
+        flush();
+    }
+};
+
+class ReplayReader
+{
+private:
+    vector<unsigned char> data;
+    size_t pos;
+    long long pendingTick; // Tick of the next event
+    char pendingKey;       // 0 once the game's end marker has been read
+
+    bool getVarint(uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; pos < data.size() && shift < 64; shift += 7)
+        {
+            unsigned char b = data[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    void readEvent()
+    {
+        uint64_t delta;
+        if (!getVarint(delta) || pos >= data.size())
+        {
+            pos = data.size(); // Truncated recording: end the game here
+            pendingKey = 0;
+            return;
+        }
+        pendingTick += delta;
+        pendingKey = data[pos++];
+    }
+
+public:
+    ReplayReader() : pos(0), pendingTick(0), pendingKey(0) {}
+
+    bool open(const string &path)
+    {
+        ifstream file(path, ios::binary);
+        if (!file.is_open())
+            return false;
+        data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        if (data.size() < 5 || !equal(REPLAY_MAGIC, REPLAY_MAGIC + 4, data.begin()) ||
+            data[4] != REPLAY_VERSION)
+            return false;
+        pos = 5;
+        return true;
+    }
+
+    // Skips whatever is left of the current game and reads the next header
+    bool nextGame(uint64_t &seed, int &width, int &height, uint64_t &level)
+    {
+        while (pendingKey != 0)
+            readEvent();
+
+        uint64_t w, h;
+        if (!getVarint(seed) || !getVarint(w) || !getVarint(h) || !getVarint(level))
+            return false;
+        width = w;
+        height = h;
+        pendingTick = 0;
+        readEvent();
+        return true;
+    }
+
+    // Next key recorded for this tick, 0 once there are no more; ticks must be queried in order
+    char inputAt(long long tick)
+    {
+        if (pendingKey == 0 || pendingTick != tick)
+            return 0;
+        char key = pendingKey;
+        readEvent();
+        return key;
+    }
+
+    bool finished(long long tick) const
+    {
+        return pendingKey == 0 && tick >= pendingTick;
+    }
+};
+
+// ============ Spectator Stream ============
+// Live game feed for other terminals, as [varint length][message] over a Unix
+// socket:
+//   'K' (new round) or 'R' (refresh) keyframe: varint width, varint height,
+//       head, status, then { varint run, glyph } runs covering the board row by row
+//   'D' head, status, varint cell count,
+//       then { varint index gap, glyph } for each changed cell in index order
+// head: zigzag varints x, y (an invincible head can leave the board)
+// status: varints score, high score, invincibility ticks, double-score ticks
+// Synced spectators get only deltas, so bandwidth follows what changed. A new
+// spectator gets a keyframe on the next frame; everyone gets one at a new
+// round and every KEYFRAME_INTERVAL frames as a refresh.
+struct SpectatorStatus
+{
+    int score;
+    int highScore;
+    int invincibleTicks; // 0 when inactive
+    int doubleScoreTicks;
+};
+
+static void appendVarint(string &out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+static void appendZigzag(string &out, int v)
+{
+    appendVarint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+class SpectatorFeed
+{
+private:
+    struct Spectator
+    {
+        int fd;
+        bool synced; // Has received a keyframe
+        string out;
+        size_t outPos;
+    };
+
+    static const int KEYFRAME_INTERVAL = 500;
+    static const size_t MAX_BACKLOG = 1 << 20; // Spectators further behind are dropped
+
+    string path;
+    int listenFd;
+    vector<Spectator> spectators;
+    long long frames;
+    string framed;
+
+    void acceptAll()
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            Spectator s;
+            s.fd = fd;
+            s.synced = false;
+            s.outPos = 0;
+            spectators.push_back(s);
+        }
+    }
+
+    // Returns false once the spectator has gone or fallen too far behind
+    static bool flush(Spectator &s)
+    {
+        while (s.outPos < s.out.size())
+        {
+            ssize_t n = send(s.fd, s.out.data() + s.outPos, s.out.size() - s.outPos, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return errno == EAGAIN && s.out.size() - s.outPos < MAX_BACKLOG;
+            }
+            s.outPos += n;
+        }
+        s.out.clear();
+        s.outPos = 0;
+        return true;
+    }
+
+    void deliver(const string &message, bool keyframe, bool everyone)
+    {
+        framed.clear();
+        appendVarint(framed, message.size());
+        framed += message;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < spectators.size(); ++i)
+        {
+            Spectator &s = spectators[i];
+            if (keyframe ? everyone || !s.synced : s.synced)
+            {
+                s.out += framed;
+                s.synced = true;
+            }
+            if (!flush(s))
+            {
+                close(s.fd);
+                continue;
+            }
+            if (kept != i)
+                spectators[kept] = move(s);
+            kept++;
+        }
+        spectators.resize(kept);
+    }
+
+public:
+    SpectatorFeed() : listenFd(-1), frames(0) {}
+
+    ~SpectatorFeed()
+    {
+        for (size_t i = 0; i < spectators.size(); ++i)
+            close(spectators[i].fd);
+        if (listenFd >= 0)
+        {
+            close(listenFd);
+            unlink(path.c_str());
+        }
+    }
+
+    bool open(const string &socketPath)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path))
+            return false;
+        strcpy(addr.sun_path, socketPath.c_str());
+
+        path = socketPath;
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(path.c_str());
+        return listenFd >= 0 && bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+               listen(listenFd, SOMAXCONN) == 0;
+    }
+
+    // Called once per frame before encoding; false means nobody is watching
+    // and the frame needn't be built at all
+    bool beginFrame()
+    {
+        acceptAll();
+        frames++;
+        return !spectators.empty();
+    }
+
+    bool refreshDue() const { return frames % KEYFRAME_INTERVAL == 0; }
+
+    bool hasWaiting() const
+    {
+        for (size_t i = 0; i < spectators.size(); ++i)
+        {
+            if (!spectators[i].synced)
+                return true;
+        }
+        return false;
+    }
+
+    bool hasSynced() const
+    {
+        for (size_t i = 0; i < spectators.size(); ++i)
+        {
+            if (spectators[i].synced)
+                return true;
+        }
+        return false;
+    }
+
+    void publishDelta(const string &message) { deliver(message, false, false); }
+
+    // To spectators waiting for one, or to all of them for a refresh
+    void publishKeyframe(const string &message, bool everyone) { deliver(message, true, everyone); }
+
+};
+
+// Spectator side: rebuilds the board's glyphs from the feed
+class SpectatorStream
+{
+private:
+    int fd;
+    string inbox;
+    size_t inboxPos;
+    bool synced;
+
+    int width;
+    int height;
+    vector<char> glyphs;
+    Point head;
+    SpectatorStatus status;
+    vector<int> changed; // Cells updated since the last takeChanges()
+
+    static bool getVarint(const string &data, size_t &pos, size_t end, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; pos < end && shift < 64; shift += 7)
+        {
+            unsigned char b = data[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    static bool getZigzag(const string &data, size_t &pos, size_t end, int &v)
+    {
+        uint64_t u;
+        if (!getVarint(data, pos, end, u))
+            return false;
+        v = (int)(u >> 1) ^ -(int)(u & 1);
+        return true;
+    }
+
+    bool readHeadAndStatus(size_t &pos, size_t end)
+    {
+        uint64_t score, highScore, invincible, doubleScore;
+        if (!getZigzag(inbox, pos, end, head.x) || !getZigzag(inbox, pos, end, head.y) ||
+            !getVarint(inbox, pos, end, score) || !getVarint(inbox, pos, end, highScore) ||
+            !getVarint(inbox, pos, end, invincible) || !getVarint(inbox, pos, end, doubleScore))
+            return false;
+        status.score = score;
+        status.highScore = highScore;
+        status.invincibleTicks = invincible;
+        status.doubleScoreTicks = doubleScore;
+        return true;
+    }
+
+    bool applyKeyframe(size_t pos, size_t end)
+    {
+        uint64_t w, h;
+        if (!getVarint(inbox, pos, end, w) || !getVarint(inbox, pos, end, h) || w == 0 || h == 0 ||
+            w > 8192 || h > 8192 || !readHeadAndStatus(pos, end))
+            return false;
+        width = w;
+        height = h;
+        glyphs.assign((size_t)width * height, ' ');
+
+        size_t cell = 0;
+        while (cell < glyphs.size())
+        {
+            uint64_t run;
+            if (!getVarint(inbox, pos, end, run) || pos >= end || run > glyphs.size() - cell)
+                return false;
+            char glyph = inbox[pos++];
+            fill(glyphs.begin() + cell, glyphs.begin() + cell + run, glyph);
+            cell += run;
+        }
+        changed.clear();
+        synced = true;
+        return true;
+    }
+
+    bool applyDelta(size_t pos, size_t end)
+    {
+        uint64_t count;
+        if (!synced || !readHeadAndStatus(pos, end) || !getVarint(inbox, pos, end, count))
+            return false;
+        uint64_t index = 0;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t gap;
+            if (!getVarint(inbox, pos, end, gap) || pos >= end)
+                return false;
+            index += gap;
+            if (index >= glyphs.size())
+                return false;
+            glyphs[index] = inbox[pos++];
+            changed.push_back(index);
+        }
+        return true;
+    }
+
+public:
+    SpectatorStream() : fd(-1), inboxPos(0), synced(false), width(0), height(0), head(0, 0)
+    {
+        status.score = status.highScore = status.invincibleTicks = status.doubleScoreTicks = 0;
+    }
+
+    ~SpectatorStream()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool connectTo(const string &path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            return false;
+        strcpy(addr.sun_path, path.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        return fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    }
+
+    int getFd() const { return fd; }
+
+    // Pull whatever the socket has; false once the game has gone away
+    bool receive()
+    {
+        char buffer[65536];
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0)
+            return errno == EINTR || errno == EAGAIN;
+        if (n == 0)
+            return false;
+        inbox.erase(0, inboxPos);
+        inboxPos = 0;
+        inbox.append(buffer, n);
+        return true;
+    }
+
+    // Apply the next complete message and report its type; false when none is
+    // buffered. A corrupt message unsyncs the stream until the next keyframe.
+    bool nextMessage(char &type)
+    {
+        size_t pos = inboxPos;
+        uint64_t length;
+        if (!getVarint(inbox, pos, inbox.size(), length) || inbox.size() - pos < length)
+            return false;
+        size_t end = pos + length;
+        inboxPos = end;
+
+        type = length > 0 ? inbox[pos] : 0;
+        bool ok = (type == 'K' || type == 'R') ? applyKeyframe(pos + 1, end)
+                                               : type == 'D' && applyDelta(pos + 1, end);
+        if (!ok)
+            synced = false;
+        return true;
+    }
+
+    bool isSynced() const { return synced; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    Point getHead() const { return head; }
+    const SpectatorStatus &getStatus() const { return status; }
+
+    char glyphAt(const Point &p) const
+    {
+        return p.x >= 0 && p.x < width && p.y >= 0 && p.y < height ? glyphs[p.y * width + p.x] : ' ';
+    }
+
+    // Cells changed since the last call, for the incremental redraw
+    void takeChanges(vector<int> &out)
+    {
+        out.swap(changed);
+        changed.clear();
+    }
+};
+
+// ============ Terminal Renderer ============
+// Diffs each frame against what the terminal already shows, cell by cell,
+// and emits only the changed runs. The whole frame is built in one
+// preallocated buffer and sent with a single write().
+class TerminalRenderer
+{
+private:
+    int fd;
+    string out;
+    vector<string> shown; // Rows currently on the terminal
+    int cursorRow;        // 0-based; -1 when unknown
+    int cursorCol;
+
+    // Unchanged cells shorter than this are resent rather than jumped over
+    static const size_t MAX_GAP = 4;
+
+    void appendInt(int v)
+    {
+        char digits[12];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v > 0);
+        while (n > 0)
+            out += digits[--n];
+    }
+
+    void moveTo(int row, int col)
+    {
+        if (row == cursorRow && col == cursorCol)
+            return;
+
+        out += "\033[";
+        if (row == cursorRow && col > cursorCol)
+        {
+            appendInt(col - cursorCol);
+            out += 'C';
+        }
+        else
+        {
+            appendInt(row + 1);
+            out += ';';
+            appendInt(col + 1);
+            out += 'H';
+        }
+        cursorRow = row;
+        cursorCol = col;
+    }
+
+    void emit(int row, const string &line, size_t from, size_t to)
+    {
+        moveTo(row, from);
+        out.append(line, from, to - from);
+        cursorCol += to - from;
+    }
+
+    void diffRow(int row, const string &line)
+    {
+        string &prev = shown[row];
+        size_t common = min(line.size(), prev.size());
+
+        size_t c = 0;
+        while (c < common)
+        {
+            if (line[c] == prev[c])
+            {
+                c++;
+                continue;
+            }
+
+            // Extend the run across short stretches of unchanged cells
+            size_t last = c;
+            for (size_t k = c + 1; k < common && k - last <= MAX_GAP; ++k)
+            {
+                if (line[k] != prev[k])
+                    last = k;
+            }
+            emit(row, line, c, last + 1);
+            c = last + 1;
+        }
+
+        if (line.size() > prev.size())
+        {
+            emit(row, line, common, line.size());
+        }
+        else if (line.size() < prev.size())
+        {
+            moveTo(row, line.size());
+            out += "\033[K";
+        }
+        prev = line;
+    }
+
+    void flushOut()
+    {
+        size_t done = 0;
+        while (done < out.size())
+        {
+            ssize_t n = write(fd, out.data() + done, out.size() - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        out.clear();
+    }
+
+public:
+    TerminalRenderer(int fd = STDOUT_FILENO) : fd(fd), cursorRow(-1), cursorCol(-1)
+    {
+        out.reserve(1 << 16);
+    }
+
+    void setOutput(int outputFd) { fd = outputFd; }
+
+    // Start over on a cleared screen with the given number of rows
+    void reset(size_t rows)
+    {
+        shown.assign(rows, string());
+        out += "\033[2J\033[H";
+        cursorRow = 0;
+        cursorCol = 0;
+    }
+
+    void present(const vector<string> &frame)
+    {
+        cout.flush(); // Keep ordering with anything written through cout
+        if (shown.size() < frame.size())
+            shown.resize(frame.size());
+
+        for (size_t row = 0; row < frame.size(); ++row)
+            diffRow(row, frame[row]);
+
+        if (!out.empty())
+            flushOut();
+    }
+};
+
+// ============ Render Thread ============
+// Lock-free triple buffer: the producer always has a free slot to fill, the
+// consumer always takes the newest complete frame, and frames the consumer
+// never got to are simply overwritten.
+template <typename Frame>
+class TripleBuffer
+{
+private:
+    static const int FRESH = 4; // Set on the middle index while it holds an unread frame
+
+    Frame slots[3];
+    atomic<int> middle;
+    int back;  // Producer-owned slot
+    int front; // Consumer-owned slot
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    Frame &writeSlot() { return slots[back]; }
+
+    // Returns true if an unread frame was dropped to make room
+    bool publish()
+    {
+        int previous = middle.exchange(back | FRESH, memory_order_acq_rel);
+        back = previous & 3;
+        return previous & FRESH;
+    }
+
+    bool acquire()
+    {
+        if (!(middle.load(memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const Frame &readSlot() const { return slots[front]; }
+};
+
+// Presents frame snapshots on its own thread so a slow terminal never
+// holds up the simulation tick.
+class RenderThread
+{
+private:
+    TerminalRenderer &renderer;
+    TripleBuffer<vector<string>> frames;
+    mutex lock;
+    condition_variable wake;
+    bool running;
+    bool pending; // Set under lock by submit() after publishing, so no frame sleeps unseen
+    thread worker;
+    long long dropped;
+
+    // Sleeps until a frame is published instead of polling the buffer
+    void loop()
+    {
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [this] { return pending || !running; });
+                if (!running)
+                    break;
+                pending = false;
+            }
+            if (frames.acquire())
+                renderer.present(frames.readSlot());
+        }
+
+        // Show the final frame before handing the terminal back
+        if (frames.acquire())
+            renderer.present(frames.readSlot());
+    }
+
+public:
+    RenderThread(TerminalRenderer &renderer) : renderer(renderer), running(false), pending(false), dropped(0) {}
+
+    ~RenderThread() { stop(); }
+
+    void start()
+    {
+        if (running)
+            return;
+        running = true;
+        worker = thread(&RenderThread::loop, this);
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+        {
+            lock_guard<mutex> guard(lock);
+            running = false;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void submit(const vector<string> &frame)
+    {
+        frames.writeSlot() = frame;
+        if (frames.publish())
+            dropped++;
+        {
+            lock_guard<mutex> guard(lock);
+            pending = true;
+        }
+        wake.notify_one();
+    }
+
+    long long getDropped() const { return dropped; }
+};
+
+// ============ Tick Scheduler ============
+// Fixed-timestep pacing on absolute CLOCK_MONOTONIC deadlines: the tick
+// period stays the same however long the tick's own work takes.
+class TickScheduler
+{
+private:
+    long long periodNs;
+    long long deadline; // Absolute time of the next tick
+    int maxCatchUp;     // Ticks we may fall behind before the schedule resyncs to now
+
+    long long ticks;
+    long long missed;  // Deadlines already past when the tick finished
+    long long resyncs; // Times we gave up catching up and dropped the backlog
+    long long sleptTicks;
+    long long totalJitterNs;
+    long long maxJitterNs;
+
+    static long long now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+public:
+    TickScheduler(int maxCatchUp = 3)
+        : periodNs(0), deadline(0), maxCatchUp(maxCatchUp), ticks(0), missed(0), resyncs(0),
+          sleptTicks(0), totalJitterNs(0), maxJitterNs(0) {}
+
+    void start() { deadline = now(); }
+
+    // Takes effect from the next deadline, so speed changes never shift past ticks
+    void setPeriod(long long ns) { periodNs = ns; }
+
+    void waitNext()
+    {
+        deadline += periodNs;
+        ticks++;
+
+        long long t = now();
+        if (t >= deadline)
+        {
+            // Late: run the next tick immediately to catch up, unless we're
+            // so far behind that replaying the backlog would look like a fast-forward
+            missed++;
+            if (t - deadline > periodNs * maxCatchUp)
+            {
+                deadline = t;
+                resyncs++;
+            }
+            return;
+        }
+
+        struct timespec ts;
+        ts.tv_sec = deadline / 1000000000LL;
+        ts.tv_nsec = deadline % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+
+        long long jitter = now() - deadline;
+        sleptTicks++;
+        totalJitterNs += jitter;
+        maxJitterNs = max(maxJitterNs, jitter);
+    }
+
+    void printStats() const
+    {
+        cout << "Ticks: " << ticks << " | Missed deadlines: " << missed
+             << " (" << resyncs << " resyncs)" << endl;
+        if (sleptTicks > 0)
+        {
+            cout << "Wake jitter: mean " << totalJitterNs / sleptTicks / 1000
+                 << " us, max " << maxJitterNs / 1000 << " us" << endl;
+        }
+    }
+};
+
+// ============ Input Thread ============
+// Reads stdin as soon as bytes arrive, decodes arrow-key escape sequences
+// across reads, and queues keys for the game thread.
+class InputThread
+{
+private:
+    SpscQueue<char, 64> keys;
+    int wakePipe[2];   // Written by stop() to end the poll loop
+    int notifyPipe[2]; // Written after queueing keys so waitKey() can block
+    thread worker;
+    bool running;
+    int escapeState; // 0 = plain, 1 = after ESC, 2 = after ESC [
+
+    void parse(char c)
+    {
+        if (escapeState == 2)
+        {
+            escapeState = 0;
+            switch (c)
+            {
+            case 'A':
+                keys.push('w');
+                return;
+            case 'B':
+                keys.push('s');
+                return;
+            case 'C':
+                keys.push('d');
+                return;
+            case 'D':
+                keys.push('a');
+                return;
+            }
+            return;
+        }
+        if (escapeState == 1)
+        {
+            escapeState = 0;
+            if (c == '[')
+            {
+                escapeState = 2;
+                return;
+            }
+        }
+        if (c == 27)
+        {
+            escapeState = 1;
+            return;
+        }
+        keys.push(c);
+    }
+
+    void loop()
+    {
+        struct pollfd fds[2];
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakePipe[0];
+        fds[1].events = POLLIN;
+
+        while (true)
+        {
+            if (::poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (fds[1].revents)
+                break;
+            if (fds[0].revents & (POLLIN | POLLHUP))
+            {
+                char buffer[64];
+                ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+                if (n == 0)
+                    break; // stdin closed
+                for (ssize_t i = 0; i < n; ++i)
+                    parse(buffer[i]);
+                if (n > 0)
+                {
+                    char signal = 1;
+                    if (write(notifyPipe[1], &signal, 1) < 0)
+                    {
+                        // Pipe already full: the consumer has a wakeup pending
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    InputThread() : running(false), escapeState(0)
+    {
+        if (pipe(wakePipe) != 0 || pipe(notifyPipe) != 0)
+        {
+            cerr << "Failed to create input pipes" << endl;
+            exit(1);
+        }
+        fcntl(notifyPipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(notifyPipe[1], F_SETFL, O_NONBLOCK);
+    }
+
+    ~InputThread()
+    {
+        stop();
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        close(notifyPipe[0]);
+        close(notifyPipe[1]);
+    }
+
+    void start()
+    {
+        if (running)
+            return;
+        running = true;
+        escapeState = 0;
+        worker = thread(&InputThread::loop, this);
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+        char signal = 1;
+        while (write(wakePipe[1], &signal, 1) < 0 && errno == EINTR)
+        {
+        }
+        worker.join();
+        while (read(wakePipe[0], &signal, 1) < 0 && errno == EINTR)
+        {
+        }
+        running = false;
+    }
+
+    // Non-blocking; false when no key is waiting
+    bool tryGetKey(char &key)
+    {
+        return keys.pop(key);
+    }
+
+    // Readable after new keys were queued, for callers with their own poll loop
+    int getNotifyFd() const { return notifyPipe[0]; }
+
+    void clearNotify()
+    {
+        char drain[64];
+        while (read(notifyPipe[0], drain, sizeof(drain)) > 0)
+        {
+        }
+    }
+
+    // Blocks until a key arrives
+    char waitKey()
+    {
+        char key;
+        while (!keys.pop(key))
+        {
+            struct pollfd fd;
+            fd.fd = notifyPipe[0];
+            fd.events = POLLIN;
+            ::poll(&fd, 1, -1);
+            clearNotify();
+        }
+        return key;
+    }
+};
+
+// ============ Game Class ============
+class Game
+{
+    friend class MicroBenchmarks;
+
+private:
+    int WIDTH;
+    int HEIGHT;
+    int requestedWidth; // Fixed board size, 0 to fit the terminal
+    int requestedHeight;
+    int viewWidth;      // Visible window onto the board
+    int viewHeight;
+    int cameraX;        // Board cell shown at the view's top-left
+    int cameraY;
+    Point lastHead;     // Repainted as body on the next frame
+    Engine engine;
+    uint64_t baseSeed;
+    int round;
+    ReplayWriter *recorder;
+    TickScheduler scheduler;
+    InputThread input;
+    SoundManager sound;
+#ifdef SNAKE_PROFILE
+    TickProfiler profiler; // Tens of KB of histograms, so only in profiling builds
+#endif
+    bool profiling;
+    Autopilot autopilot;
+    bool autopilotEnabled;
+    struct termios oldt, newt;
+    Leaderboard leaderboard;
+    vector<string> screenBuffer;
+    TerminalRenderer renderer;
+    RenderThread renderThread;
+    bool threadedRendering;
+    SpectatorFeed *spectators; // nullptr unless --spectate
+    string spectatorMessage;
+    vector<int> spectatorCells;
+    string savePath;           // Q suspends the round here; empty to quit outright
+    bool resumed;              // First round continues a loaded snapshot
+
+    void setupTerminal()
+    {
+        tcgetattr(STDIN_FILENO, &oldt);
+        newt = oldt;
+        newt.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+
+        int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+        fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    void restoreTerminal()
+    {
+        tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+
+        int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+        fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
+    void getTerminalSize()
+    {
+        if (requestedWidth > 0)
+        {
+            WIDTH = requestedWidth;
+            HEIGHT = requestedHeight;
+            return;
+        }
+
+        struct winsize w;
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+
+        WIDTH = min(60, (int)w.ws_col - 4);
+        HEIGHT = min(30, (int)w.ws_row - 10);
+
+        if (WIDTH < 20)
+            WIDTH = 20;
+        if (HEIGHT < 15)
+            HEIGHT = 15;
+    }
+
+    // Show as much of the board as the terminal fits, centred on the head
+    void fitViewport(const Point &head)
+    {
+        struct winsize w = {};
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+
+        viewWidth = min(WIDTH, max(20, (int)w.ws_col - 4));
+        viewHeight = min(HEIGHT, max(15, (int)w.ws_row - 10));
+
+        cameraX = max(0, min(head.x - viewWidth / 2, WIDTH - viewWidth));
+        cameraY = max(0, min(head.y - viewHeight / 2, HEIGHT - viewHeight));
+        lastHead = head;
+    }
+
+    // Scroll just enough to keep the head a quarter of the view from the edge
+    static int followAxis(int camera, int head, int view, int board)
+    {
+        int margin = view / 4;
+        if (head < camera + margin)
+            camera = head - margin;
+        else if (head >= camera + view - margin)
+            camera = head - view + margin + 1;
+        return max(0, min(camera, board - view));
+    }
+
+    void clearScreen()
+    {
+        cout << "\033[2J\033[H";
+    }
+
+    void hideCursor()
+    {
+        cout << "\033[?25l";
+    }
+
+    void showCursor()
+    {
+        cout << "\033[?25h";
+    }
+
+    void initializeBuffer()
+    {
+        screenBuffer.clear();
+
+        // Top border
+        string topBorder = "+";
+        for (int i = 0; i < viewWidth; ++i)
+            topBorder += "-";
+        topBorder += "+";
+        screenBuffer.push_back(topBorder);
+
+        // Game area
+        for (int y = 0; y < viewHeight; ++y)
+        {
+            string line = "|";
+            for (int x = 0; x < viewWidth; ++x)
+            {
+                line += " ";
+            }
+            line += "|";
+            screenBuffer.push_back(line);
+        }
+
+        // Bottom border
+        string bottomBorder = "+";
+        for (int i = 0; i < viewWidth; ++i)
+            bottomBorder += "-";
+        bottomBorder += "+";
+        screenBuffer.push_back(bottomBorder);
+
+        // Status lines
+        screenBuffer.push_back("");
+        screenBuffer.push_back("");
+        screenBuffer.push_back("Controls: W/A/S/D or Arrow Keys | Q to quit");
+    }
+
+    char cellSymbol(const Point &p, const Point &head) const
+    {
+        const Board &board = engine.getBoard();
+        if (board.snakeAt(p) > 0)
+            return p == head ? 'O' : 'o';
+        if (board.has(p, CELL_POWERUP))
+        {
+            for (const auto &powerup : engine.getPowerUps())
+            {
+                if (powerup.isActive() && powerup.getPosition() == p)
+                    return powerup.getSymbol();
+            }
+        }
+        if (board.has(p, CELL_FOOD))
+            return '*';
+        if (board.has(p, CELL_OBSTACLE))
+            return '#';
+        return ' ';
+    }
+
+    // Repaint the whole view after a scroll, otherwise only the listed cells
+    // and the old head, so the cost never depends on the board's size
+    template <typename SymbolFn>
+    void paintBoard(const Point &head, const vector<int> &changes, bool repaintAll, SymbolFn symbol)
+    {
+        int newCameraX = followAxis(cameraX, head.x, viewWidth, WIDTH);
+        int newCameraY = followAxis(cameraY, head.y, viewHeight, HEIGHT);
+        if (repaintAll || newCameraX != cameraX || newCameraY != cameraY)
+        {
+            cameraX = newCameraX;
+            cameraY = newCameraY;
+            for (int y = 0; y < viewHeight; ++y)
+            {
+                for (int x = 0; x < viewWidth; ++x)
+                    screenBuffer[y + 1][x + 1] = symbol(Point(cameraX + x, cameraY + y));
+            }
+        }
+        else
+        {
+            auto paintCell = [&](const Point &p) {
+                int vx = p.x - cameraX;
+                int vy = p.y - cameraY;
+                if (vx >= 0 && vx < viewWidth && vy >= 0 && vy < viewHeight)
+                    screenBuffer[vy + 1][vx + 1] = symbol(p);
+            };
+            for (int i : changes)
+                paintCell(Point(i % WIDTH, i / WIDTH));
+            paintCell(lastHead);
+        }
+        lastHead = head;
+    }
+
+    // Formatted into stack buffers and assigned over the old lines, whose
+    // capacity is reused, so a frame's status costs no heap allocation
+    void updateStatus(const Point &head, const SpectatorStatus &status)
+    {
+        char line[160];
+        int n = snprintf(line, sizeof(line), "Score: %d | High Score: %d", status.score, status.highScore);
+        if (viewWidth < WIDTH || viewHeight < HEIGHT)
+            n += snprintf(line + n, sizeof(line) - n, " | Pos: %d,%d of %dx%d", head.x, head.y, WIDTH, HEIGHT);
+        screenBuffer[viewHeight + 2].assign(line, n);
+
+        n = snprintf(line, sizeof(line), "Active Effects: ");
+        if (status.invincibleTicks > 0)
+            n += snprintf(line + n, sizeof(line) - n, "[INVINCIBLE:%d] ", status.invincibleTicks);
+        if (status.doubleScoreTicks > 0)
+            n += snprintf(line + n, sizeof(line) - n, "[DOUBLE SCORE:%d] ", status.doubleScoreTicks);
+        if (status.invincibleTicks <= 0 && status.doubleScoreTicks <= 0)
+            n += snprintf(line + n, sizeof(line) - n, "None");
+        screenBuffer[viewHeight + 3].assign(line, n);
+    }
+
+    SpectatorStatus currentStatus()
+    {
+        SpectatorStatus status;
+        status.score = engine.getScore();
+        status.highScore = leaderboard.getHighScore();
+        status.invincibleTicks = engine.isInvincible() ? engine.getInvincibilityTimer() : 0;
+        status.doubleScoreTicks = engine.isDoubleScore() ? engine.getDoubleScoreTimer() : 0;
+        return status;
+    }
+
+    void updateBuffer(bool repaintAll = false)
+    {
+        Point head = engine.getSnake().getHead();
+        paintBoard(head, engine.getBoard().getChanges(), repaintAll,
+                   [&](const Point &p) { return cellSymbol(p, head); });
+        updateStatus(head, currentStatus());
+    }
+
+    void appendSpectatorHeader(char type, const Point &head)
+    {
+        SpectatorStatus status = currentStatus();
+        spectatorMessage.clear();
+        spectatorMessage += type;
+        if (type != 'D')
+        {
+            appendVarint(spectatorMessage, WIDTH);
+            appendVarint(spectatorMessage, HEIGHT);
+        }
+        appendZigzag(spectatorMessage, head.x);
+        appendZigzag(spectatorMessage, head.y);
+        appendVarint(spectatorMessage, status.score);
+        appendVarint(spectatorMessage, status.highScore);
+        appendVarint(spectatorMessage, status.invincibleTicks);
+        appendVarint(spectatorMessage, status.doubleScoreTicks);
+    }
+
+    // Run-length encode the whole board
+    void encodeKeyframe(const Point &head, bool newRound)
+    {
+        appendSpectatorHeader(newRound ? 'K' : 'R', head);
+        char run = cellSymbol(Point(0, 0), head);
+        uint64_t runLength = 0;
+        for (int y = 0; y < HEIGHT; ++y)
+        {
+            for (int x = 0; x < WIDTH; ++x)
+            {
+                char c = cellSymbol(Point(x, y), head);
+                if (c != run)
+                {
+                    appendVarint(spectatorMessage, runLength);
+                    spectatorMessage += run;
+                    run = c;
+                    runLength = 0;
+                }
+                runLength++;
+            }
+        }
+        appendVarint(spectatorMessage, runLength);
+        spectatorMessage += run;
+    }
+
+    // The cells the last tick changed, plus the previous head, which turned into body
+    void encodeDelta(const Point &head, const Point &previousHead)
+    {
+        appendSpectatorHeader('D', head);
+        const Board &board = engine.getBoard();
+        spectatorCells = board.getChanges();
+        if (board.inBounds(previousHead))
+            spectatorCells.push_back(previousHead.y * WIDTH + previousHead.x);
+        sort(spectatorCells.begin(), spectatorCells.end());
+        spectatorCells.erase(unique(spectatorCells.begin(), spectatorCells.end()), spectatorCells.end());
+
+        appendVarint(spectatorMessage, spectatorCells.size());
+        int previous = 0;
+        for (int i : spectatorCells)
+        {
+            appendVarint(spectatorMessage, i - previous);
+            spectatorMessage += cellSymbol(Point(i % WIDTH, i / WIDTH), head);
+            previous = i;
+        }
+    }
+
+    void publishSpectatorFrame(const Point &previousHead, bool newRound)
+    {
+        if (!spectators || !spectators->beginFrame())
+            return;
+
+        Point head = engine.getSnake().getHead();
+        bool everyone = newRound || spectators->refreshDue();
+        if (!everyone && spectators->hasSynced())
+        {
+            encodeDelta(head, previousHead);
+            spectators->publishDelta(spectatorMessage);
+        }
+        if (everyone || spectators->hasWaiting())
+        {
+            encodeKeyframe(head, newRound);
+            spectators->publishKeyframe(spectatorMessage, everyone);
+        }
+    }
+
+    void draw()
+    {
+        Point previousHead = lastHead;
+        updateBuffer();
+        publishSpectatorFrame(previousHead, false);
+
+        if (threadedRendering)
+            renderThread.submit(screenBuffer);
+        else
+            renderer.present(screenBuffer);
+    }
+
+    void drawFullScreen()
+    {
+        fitViewport(engine.getSnake().getHead());
+        initializeBuffer();
+        updateBuffer(true);
+        publishSpectatorFrame(lastHead, true);
+        renderer.reset(screenBuffer.size());
+        renderer.present(screenBuffer);
+        if (threadedRendering)
+            renderThread.start();
+    }
+
+#ifdef SNAKE_PROFILE
+    TickProfiler *profilerOrNull() { return profiling ? &profiler : nullptr; }
+
+    void checkProfileDump()
+    {
+        if (profileDumpRequested)
+        {
+            profileDumpRequested = 0;
+            if (profiling)
+                profiler.dump(cerr);
+        }
+    }
+#else
+    void checkProfileDump() {}
+#endif
+
+    void playEventSounds(int events)
+    {
+        if (events & EVENT_COLLISION)
+        {
+            sound.play(SOUND_COLLISION);
+            sound.play(SOUND_GAME_OVER);
+        }
+        if (events & EVENT_EAT)
+            sound.play(SOUND_EAT);
+        if (events & EVENT_POWERUP)
+            sound.play(SOUND_POWERUP);
+    }
+
+public:
+    // Round n plays with seed + n so every round can be replayed on its own
+    Game(uint64_t seed) : WIDTH(40), HEIGHT(25), requestedWidth(0), requestedHeight(0),
+                          viewWidth(40), viewHeight(25), cameraX(0), cameraY(0), baseSeed(seed), round(0), recorder(nullptr), profiling(false),
+                          autopilotEnabled(false),
+                          renderThread(renderer), threadedRendering(false), spectators(nullptr), resumed(false)
+    {
+        engine.setChangeTracking(true);
+    }
+
+    // Play on a fixed board instead of one sized to the terminal; boards larger
+    // than the screen scroll to follow the head
+    void setBoardSize(int width, int height)
+    {
+        requestedWidth = width;
+        requestedHeight = height;
+    }
+
+    // Phase histograms go to stderr on exit and on SIGUSR1
+    void setProfiling(bool enabled)
+    {
+        profiling = enabled;
+#ifdef SNAKE_PROFILE
+        engine.setProfiler(profilerOrNull());
+#endif
+    }
+
+    // Let the bot steer; keys still work, so Q quits or suspends as usual
+    void setAutopilot(bool enabled) { autopilotEnabled = enabled; }
+
+    // Draw on a dedicated thread so terminal throughput can't slow the tick
+    void setThreadedRendering(bool enabled) { threadedRendering = enabled; }
+
+    void setRecorder(ReplayWriter *writer) { recorder = writer; }
+
+    // Publish every frame to spectators connected to the feed's socket
+    void setSpectatorFeed(SpectatorFeed *feed) { spectators = feed; }
+
+    // Pressing Q mid-round writes a snapshot here instead of ending the game
+    void setSaveFile(const string &path) { savePath = path; }
+
+    void setLevelPack(const LevelPack *pack) { engine.setLevelPack(pack); }
+
+    // Start with a suspended round; the snapshot is consumed once loaded
+    bool resume(const string &path)
+    {
+        if (!engine.loadSnapshot(path))
+            return false;
+        unlink(path.c_str());
+        WIDTH = engine.getWidth();
+        HEIGHT = engine.getHeight();
+        requestedWidth = WIDTH;
+        requestedHeight = HEIGHT;
+        resumed = true;
+        return true;
+    }
+
+    void run()
+    {
+        setupTerminal();
+        hideCursor();
+        input.start();
+        sound.start();
+
+        bool running = true;
+        bool suspended = false;
+
+        while (running)
+        {
+            // A resumed round can't be replayed from its seed, so it isn't recorded
+            bool recording = recorder && !resumed;
+            if (resumed)
+            {
+                resumed = false;
+                round++;
+            }
+            else
+            {
+                getTerminalSize();
+                engine.seed(baseSeed + round++);
+                engine.reset(WIDTH, HEIGHT);
+            }
+            if (recording)
+                recorder->beginGame(engine.getSeed(), WIDTH, HEIGHT, engine.getLevelFingerprint());
+
+            // Show instructions
+            clearScreen();
+            cout << "=== SNAKE GAME - ENHANCED EDITION ===" << endl;
+            cout << "Controls: W/A/S/D or Arrow Keys" << endl;
+            cout << "Goal: Eat food (*) and collect powerups!" << endl;
+            cout << "\nPowerups:" << endl;
+            cout << "  S - Speed Boost (faster movement)" << endl;
+            cout << "  L - Slow Motion (easier control)" << endl;
+            cout << "  D - Double Score (2x points)" << endl;
+            cout << "  I - Invincibility (can't die)" << endl;
+            cout << "  R - Shrink (remove tail segment)" << endl;
+            cout << "\nAvoid walls (#), obstacles, and yourself!" << endl;
+            cout << "Play Area: " << WIDTH << "x" << HEIGHT << endl;
+            cout << "Current High Score: " << leaderboard.getHighScore() << endl;
+            cout << "\nPress any key to start..." << endl;
+
+            input.waitKey();
+
+            drawFullScreen();
+
+            // Game loop
+            long long tick = 0;
+            auto startTime = chrono::steady_clock::now();
+            scheduler.start();
+            while (!engine.isGameOver() && !suspended)
+            {
+                {
+                    PROFILE_PHASE(profilerOrNull(), PHASE_TICK);
+                    {
+                        PROFILE_PHASE(profilerOrNull(), PHASE_DRAW);
+                        draw();
+                    }
+
+                    {
+                        PROFILE_PHASE(profilerOrNull(), PHASE_INPUT);
+                        char key;
+                        while (!suspended && input.tryGetKey(key))
+                        {
+                            if ((key == 'q' || key == 'Q') && !savePath.empty() && engine.saveSnapshot(savePath))
+                                suspended = true;
+                            else if (engine.queueInput(key) && recording)
+                                recorder->recordInput(tick, key);
+                        }
+                        if (autopilotEnabled && !suspended)
+                        {
+                            key = autopilot.chooseKey(engine);
+                            if (key != 0 && engine.queueInput(key) && recording)
+                                recorder->recordInput(tick, key);
+                        }
+                    }
+                    if (suspended)
+                        break;
+                    playEventSounds(engine.step(0));
+                    tick++;
+                }
+                checkProfileDump();
+
+                PROFILE_PHASE(profilerOrNull(), PHASE_SLEEP);
+                scheduler.setPeriod(engine.getSpeed() * 1000LL);
+                scheduler.waitNext();
+            }
+            renderThread.stop();
+            if (recording)
+                recorder->endGame(tick);
+            if (suspended)
+                break;
+
+            int score = engine.getScore();
+            ScoreEntry entry;
+            entry.score = score;
+            entry.length = engine.getLength();
+            entry.durationMs =
+                chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
+            entry.seed = engine.getSeed();
+            entry.timestamp = time(0);
+            bool saved = leaderboard.record(entry);
+
+            // Game over screen
+            clearScreen();
+            cout << (engine.isBoardFull() ? "=== BOARD FULL - YOU WIN! ===" : "=== GAME OVER ===") << endl;
+            cout << "Final Score: " << score << endl;
+            cout << "High Score: " << leaderboard.getHighScore() << endl;
+            if (score > leaderboard.getPreviousBest())
+            {
+                cout << "🎉 NEW HIGH SCORE! 🎉" << endl;
+            }
+            if (!saved)
+                cout << "(Could not save this score)" << endl;
+            cout << "\nTop scores:" << endl;
+            leaderboard.print(cout, 5);
+            cout << endl;
+            cout << "Press R to restart or Q to quit: ";
+            cout.flush();
+
+            char choice = 0;
+            while (choice != 'r' && choice != 'R' && choice != 'q' && choice != 'Q')
+            {
+                choice = input.waitKey();
+            }
+
+            if (choice == 'q' || choice == 'Q')
+            {
+                running = false;
+            }
+        }
+
+        input.stop();
+        sound.stop();
+        showCursor();
+        restoreTerminal();
+        clearScreen();
+        if (suspended)
+            cout << "Game saved to " << savePath << " - continue with --resume " << savePath << endl;
+        cout << "Thanks for playing!" << endl;
+        cout << "Final High Score: " << leaderboard.getHighScore() << endl;
+        scheduler.printStats();
+#ifdef SNAKE_PROFILE
+        if (profiling)
+            profiler.dump(cerr);
+#endif
+    }
+
+    // Re-run recorded games at their original speed through draw(); Q stops
+    // playback. False when a game was recorded on a level the pack doesn't give.
+    bool playReplay(ReplayReader &replay)
+    {
+        setupTerminal();
+        hideCursor();
+        input.start();
+        sound.start();
+
+        uint64_t seed, level;
+        bool quit = false;
+        bool levelMismatch = false;
+        while (!quit && replay.nextGame(seed, WIDTH, HEIGHT, level))
+        {
+            engine.seed(seed);
+            engine.reset(WIDTH, HEIGHT);
+            if (engine.getLevelFingerprint() != level)
+            {
+                levelMismatch = true;
+                break;
+            }
+            drawFullScreen();
+
+            long long tick = 0;
+            scheduler.start();
+            while (!engine.isGameOver() && !replay.finished(tick))
+            {
+                draw();
+
+                char key;
+                while (input.tryGetKey(key))
+                {
+                    if (key == 'q' || key == 'Q')
+                        quit = true;
+                }
+                if (quit)
+                    break;
+
+                while ((key = replay.inputAt(tick)) != 0)
+                    engine.queueInput(key);
+                playEventSounds(engine.step(0));
+                tick++;
+
+                scheduler.setPeriod(engine.getSpeed() * 1000LL);
+                scheduler.waitNext();
+            }
+            renderThread.stop();
+        }
+
+        input.stop();
+        sound.stop();
+        showCursor();
+        restoreTerminal();
+        clearScreen();
+        if (levelMismatch)
+        {
+            cerr << "Replay was recorded on a different layout; "
+                 << "play it with the --levels pack (or none) it was recorded with" << endl;
+            return false;
+        }
+        cout << "Replay finished." << endl;
+        scheduler.printStats();
+        return true;
+    }
+
+    // Follow another terminal's game through its spectator feed; Q stops watching
+    void watch(SpectatorStream &stream)
+    {
+        setupTerminal();
+        hideCursor();
+        input.start();
+        clearScreen();
+        cout << "Waiting for the next keyframe..." << endl;
+
+        vector<int> changes;
+        bool watching = true;
+        while (watching)
+        {
+            struct pollfd fds[2];
+            fds[0].fd = stream.getFd();
+            fds[0].events = POLLIN;
+            fds[1].fd = input.getNotifyFd();
+            fds[1].events = POLLIN;
+            if (::poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+                input.clearNotify();
+                char key;
+                while (input.tryGetKey(key))
+                {
+                    if (key == 'q' || key == 'Q')
+                        watching = false;
+                }
+            }
+            if (!watching || !(fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (!stream.receive())
+                break;
+
+            // Catch up on everything buffered, then draw once
+            char type;
+            bool fullRedraw = false;
+            bool newRound = false;
+            bool received = false;
+            while (stream.nextMessage(type))
+            {
+                received = true;
+                fullRedraw = fullRedraw || type == 'K' || type == 'R';
+                newRound = newRound || type == 'K';
+            }
+            if (!received || !stream.isSynced())
+                continue;
+
+            Point head = stream.getHead();
+            auto glyph = [&stream](const Point &p) { return stream.glyphAt(p); };
+            stream.takeChanges(changes);
+            if (fullRedraw)
+            {
+                // Refresh keyframes keep the camera; a new round re-fits it
+                if (newRound || screenBuffer.empty() || WIDTH != stream.getWidth() || HEIGHT != stream.getHeight())
+                {
+                    WIDTH = stream.getWidth();
+                    HEIGHT = stream.getHeight();
+                    fitViewport(head);
+                    initializeBuffer();
+                    renderer.reset(screenBuffer.size());
+                }
+                paintBoard(head, changes, true, glyph);
+                updateStatus(head, stream.getStatus());
+            }
+            else
+            {
+                paintBoard(head, changes, false, glyph);
+                updateStatus(head, stream.getStatus());
+            }
+            renderer.present(screenBuffer);
+        }
+
+        input.stop();
+        showCursor();
+        restoreTerminal();
+        clearScreen();
+        cout << "Stopped watching." << endl;
+    }
+};
+
+// ============ Headless Simulation ============
+class HeadlessRunner
+{
+private:
+    int width;
+    int height;
+    long long ticks;
+    string script; // Keys replayed one per tick ('.' = no input); random when empty
+    uint64_t seed;
+    Engine engine;
+    Rng inputRng;
+#ifdef SNAKE_PROFILE
+    TickProfiler profiler;
+#endif
+    bool profiling;
+    Autopilot autopilot;
+    bool autopilotEnabled;
+    bool resumed;    // First game continues a loaded snapshot
+    string savePath; // Snapshot of the final state, empty for none
+
+    char nextInput(long long tick)
+    {
+        if (autopilotEnabled)
+            return autopilot.chooseKey(engine);
+
+        if (!script.empty())
+        {
+            char c = script[tick % script.size()];
+            return c == '.' ? 0 : c;
+        }
+
+        static const char keys[] = {0, 0, 0, 0, 'w', 'a', 's', 'd'};
+        return keys[inputRng.uniform(8)];
+    }
+
+public:
+    HeadlessRunner(int width, int height, long long ticks, const string &script, uint64_t seed)
+        : width(width), height(height), ticks(ticks), script(script), seed(seed),
+          inputRng(seed ^ 0x5eedf00dULL), profiling(false), autopilotEnabled(false), resumed(false) {}
+
+    void setAutopilot(bool enabled) { autopilotEnabled = enabled; }
+
+    // Start from a saved position; later games use the snapshot's board size
+    bool resume(const string &path)
+    {
+        if (!engine.loadSnapshot(path))
+            return false;
+        width = engine.getWidth();
+        height = engine.getHeight();
+        resumed = true;
+        return true;
+    }
+
+    void setSaveFile(const string &path) { savePath = path; }
+
+    void setLevelPack(const LevelPack *pack) { engine.setLevelPack(pack); }
+
+    void setProfiling(bool enabled)
+    {
+        profiling = enabled;
+#ifdef SNAKE_PROFILE
+        engine.setProfiler(enabled ? &profiler : nullptr);
+#endif
+    }
+
+    void run()
+    {
+        long long games = 1;
+        long long totalScore = 0;
+        int bestScore = 0;
+        if (!resumed)
+        {
+            engine.seed(seed);
+            engine.reset(width, height);
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (long long t = 0; t < ticks; ++t)
+        {
+            {
+                PROFILE_PHASE(profiling ? &profiler : nullptr, PHASE_TICK);
+                engine.step(nextInput(t));
+            }
+#ifdef SNAKE_PROFILE
+            if (profileDumpRequested && profiling)
+            {
+                profileDumpRequested = 0;
+                profiler.dump(cerr);
+            }
+#endif
+            if (engine.isGameOver())
+            {
+                totalScore += engine.getScore();
+                bestScore = max(bestScore, engine.getScore());
+                engine.reset(width, height);
+                games++;
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (!savePath.empty() && !engine.saveSnapshot(savePath))
+            cerr << "Cannot write snapshot: " << savePath << endl;
+
+        cout << "Seed: " << seed << endl;
+        cout << "Ticks: " << ticks << endl;
+        cout << "Games: " << games << endl;
+        cout << "Best Score: " << bestScore << endl;
+        cout << "Average Score: " << (games > 1 ? (double)totalScore / (games - 1) : 0.0) << endl;
+        cout << "Elapsed: " << seconds << " s" << endl;
+        cout << "Ticks/sec: " << (long long)(seconds > 0 ? ticks / seconds : 0) << endl;
+#ifdef SNAKE_PROFILE
+        if (profiling)
+            profiler.dump(cerr);
+#endif
+    }
+};
+
+// Re-simulates every game of a replay without the terminal, as fast as possible
+class FastReplayRunner
+{
+private:
+    ReplayReader &replay;
+    Engine engine;
+
+public:
+    FastReplayRunner(ReplayReader &replay) : replay(replay) {}
+
+    // Games recorded with a level pack only replay with the same pack
+    void setLevelPack(const LevelPack *pack) { engine.setLevelPack(pack); }
+
+    // False when a game was recorded on a level the pack doesn't give
+    bool run()
+    {
+        uint64_t seed, level;
+        int width, height;
+        int games = 0;
+        long long totalTicks = 0;
+
+        auto start = chrono::steady_clock::now();
+        while (replay.nextGame(seed, width, height, level))
+        {
+            engine.seed(seed);
+            engine.reset(width, height);
+            if (engine.getLevelFingerprint() != level)
+            {
+                cerr << "Game " << games + 1 << " was recorded on a different layout; "
+                     << "replay it with the --levels pack (or none) it was recorded with" << endl;
+                return false;
+            }
+
+            long long tick = 0;
+            while (!engine.isGameOver() && !replay.finished(tick))
+            {
+                char key;
+                while ((key = replay.inputAt(tick)) != 0)
+                    engine.queueInput(key);
+                engine.step(0);
+                tick++;
+            }
+            totalTicks += tick;
+            games++;
+
+            cout << "Game " << games << ": seed " << seed << ", " << width << "x" << height
+                 << ", score " << engine.getScore() << ", length " << engine.getLength()
+                 << ", ticks " << tick << endl;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "Replayed " << games << " games, " << totalTicks << " ticks" << endl;
+        cout << "Ticks/sec: " << (long long)(seconds > 0 ? totalTicks / seconds : 0) << endl;
+        return true;
+    }
+};
+
+// ============ Batch Simulation ============
+// Thread pool where each worker drains its own task deque from the back and
+// steals from the front of other workers' deques once it runs dry.
+class WorkStealingPool
+{
+private:
+    struct WorkerQueue
+    {
+        mutex lock;
+        deque<function<void(int)>> tasks;
+    };
+
+    vector<unique_ptr<WorkerQueue>> queues;
+
+    bool popLocal(int worker, function<void(int)> &task)
+    {
+        WorkerQueue &q = *queues[worker];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty())
+            return false;
+        task = move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int worker, function<void(int)> &task)
+    {
+        for (size_t i = 1; i < queues.size(); ++i)
+        {
+            WorkerQueue &q = *queues[(worker + i) % queues.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty())
+            {
+                task = move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int worker)
+    {
+        function<void(int)> task;
+        while (popLocal(worker, task) || steal(worker, task))
+        {
+            task(worker);
+        }
+    }
+
+public:
+    WorkStealingPool(int threads)
+    {
+        for (int i = 0; i < max(1, threads); ++i)
+            queues.push_back(unique_ptr<WorkerQueue>(new WorkerQueue));
+    }
+
+    int size() const { return queues.size(); }
+
+    // Tasks receive the index of the worker running them
+    void submit(int worker, function<void(int)> task)
+    {
+        WorkerQueue &q = *queues[worker % queues.size()];
+        lock_guard<mutex> guard(q.lock);
+        q.tasks.push_back(move(task));
+    }
+
+    // Run until every queue is empty; tasks must not submit further tasks
+    void runAll()
+    {
+        vector<thread> threads;
+        for (int i = 1; i < size(); ++i)
+            threads.push_back(thread(&WorkStealingPool::workerLoop, this, i));
+        workerLoop(0);
+        for (auto &t : threads)
+            t.join();
+    }
+};
+
+struct GameResult
+{
+    int score;
+    int length;
+    long long ticks;
+};
+
+// Per-worker state with a cache line of padding on each side, so workers
+// updating neighbouring slots never write the same line. Padded rather than
+// alignas(64), which C++11 new doesn't honour.
+template <typename T>
+struct WorkerSlot
+{
+    char before[64];
+    T value;
+    char after[64];
+
+    WorkerSlot() : value() {}
+};
+
+class BatchRunner
+{
+private:
+    int width;
+    int height;
+    long long games;
+    int threads;
+    uint64_t baseSeed; // Game g plays with seed baseSeed + g
+    long long maxTicks; // Cap so an endlessly circling snake can't stall a worker
+    bool useAutopilot;
+    const LevelPack *levels;
+
+    static void printDistribution(const string &name, vector<long long> values)
+    {
+        sort(values.begin(), values.end());
+        double sum = 0;
+        for (long long v : values)
+            sum += v;
+        size_t n = values.size();
+        cout << name << ": mean " << sum / n
+             << " | min " << values[0]
+             << " | p50 " << values[n / 2]
+             << " | p90 " << values[n * 9 / 10]
+             << " | p99 " << values[n * 99 / 100]
+             << " | max " << values[n - 1] << endl;
+    }
+
+    // Plays with the bot when one is given, random keys otherwise
+    GameResult playGame(Engine &engine, Autopilot *pilot, uint64_t seed) const
+    {
+        static const char keys[] = {0, 0, 0, 0, 'w', 'a', 's', 'd'};
+        Rng inputRng(seed ^ 0x5eedf00dULL);
+
+        engine.seed(seed);
+        engine.reset(width, height);
+
+        GameResult result;
+        result.ticks = 0;
+        while (!engine.isGameOver() && result.ticks < maxTicks)
+        {
+            engine.step(pilot ? pilot->chooseKey(engine) : keys[inputRng.uniform(8)]);
+            result.ticks++;
+        }
+        result.score = engine.getScore();
+        result.length = engine.getLength();
+        return result;
+    }
+
+public:
+    BatchRunner(int width, int height, long long games, int threads, uint64_t seed)
+        : width(width), height(height), games(games), threads(threads), baseSeed(seed),
+          maxTicks(1000000), useAutopilot(false), levels(nullptr) {}
+
+    void setAutopilot(bool enabled) { useAutopilot = enabled; }
+
+    // Shared read-only by every worker's engine
+    void setLevelPack(const LevelPack *pack) { levels = pack; }
+
+    void run()
+    {
+        WorkStealingPool pool(threads);
+
+        // Per-worker engines and results: workers never touch shared state while playing
+        vector<unique_ptr<Engine>> engines;
+        vector<unique_ptr<Autopilot>> pilots;
+        vector<WorkerSlot<vector<GameResult>>> results(pool.size());
+        for (int i = 0; i < pool.size(); ++i)
+        {
+            engines.push_back(unique_ptr<Engine>(new Engine));
+            engines.back()->setLevelPack(levels);
+            pilots.push_back(unique_ptr<Autopilot>(useAutopilot ? new Autopilot : nullptr));
+        }
+
+        long long chunk = max(1LL, games / (pool.size() * 16));
+        int next = 0;
+        for (long long first = 0; first < games; first += chunk)
+        {
+            long long last = min(games, first + chunk);
+            pool.submit(next++, [this, first, last, &engines, &pilots, &results](int worker) {
+                for (long long g = first; g < last; ++g)
+                {
+                    results[worker].value.push_back(playGame(*engines[worker], pilots[worker].get(), baseSeed + g));
+                }
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        pool.runAll();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        vector<long long> scores, lengths, ticks;
+        long long totalTicks = 0;
+        for (const auto &workerResults : results)
+        {
+            for (const auto &r : workerResults.value)
+            {
+                scores.push_back(r.score);
+                lengths.push_back(r.length);
+                ticks.push_back(r.ticks);
+                totalTicks += r.ticks;
+            }
+        }
+
+        cout << "Games: " << games << " on " << pool.size() << " threads (seed " << baseSeed << ")" << endl;
+        cout << "Elapsed: " << seconds << " s" << endl;
+        cout << "Games/sec: " << (long long)(seconds > 0 ? games / seconds : 0) << endl;
+        cout << "Ticks/sec: " << (long long)(seconds > 0 ? totalTicks / seconds : 0) << endl;
+        if (games > 0)
+        {
+            printDistribution("Score", scores);
+            printDistribution("Length", lengths);
+            printDistribution("Survival ticks", ticks);
+        }
+    }
+};
+
+// Generates a level pack offline: one task per chunk of levels on the
+// work-stealing pool, each worker with its own generator, and a level that
+// fails validation is retried from the next seed in its own sequence
+class LevelPackBuilder
+{
+private:
+    int width;
+    int height;
+    long long count;
+    int style; // LevelStyle, or LEVEL_STYLE_COUNT to cycle through all of them
+    double density;
+    int threads;
+    uint64_t baseSeed;
+
+    static const int MAX_ATTEMPTS = 64;
+
+public:
+    LevelPackBuilder(int width, int height, long long count, int style, double density, int threads, uint64_t seed)
+        : width(width), height(height), count(count), style(style), density(density), threads(threads),
+          baseSeed(seed) {}
+
+    bool run(const string &path)
+    {
+        WorkStealingPool pool(threads);
+        vector<unique_ptr<LevelGenerator>> generators;
+        for (int i = 0; i < pool.size(); ++i)
+            generators.push_back(unique_ptr<LevelGenerator>(new LevelGenerator(width, height, density)));
+
+        // Slots are written by exactly one task each, so workers share nothing
+        vector<Level> levels(count);
+        vector<char> valid(count, 0);
+        vector<WorkerSlot<long long>> rejected(pool.size());
+
+        long long chunk = max(1LL, count / (pool.size() * 16));
+        int next = 0;
+        for (long long first = 0; first < count; first += chunk)
+        {
+            long long last = min(count, first + chunk);
+            pool.submit(next++, [this, first, last, &generators, &levels, &valid, &rejected](int worker) {
+                for (long long i = first; i < last; ++i)
+                {
+                    LevelStyle levelStyle = (LevelStyle)(style == LEVEL_STYLE_COUNT ? i % LEVEL_STYLE_COUNT : style);
+                    Rng seeds(baseSeed ^ ((uint64_t)i * 0x9E3779B97F4A7C15ULL));
+                    for (int attempt = 0; attempt < MAX_ATTEMPTS && !valid[i]; ++attempt)
+                    {
+                        valid[i] = generators[worker]->generate(levelStyle, seeds.next(), levels[i]);
+                        rejected[worker].value += !valid[i];
+                    }
+                }
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        pool.runAll();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        LevelPack pack;
+        long long totalRejected = 0;
+        double wallFraction = 0;
+        for (long long i = 0; i < count; ++i)
+        {
+            if (!valid[i])
+                continue;
+            pack.add(levels[i]);
+            wallFraction += (double)levels[i].walls.size() / (width * height);
+        }
+        for (const auto &r : rejected)
+            totalRejected += r.value;
+
+        cout << "Levels: " << pack.size() << " of " << count << " (" << width << "x" << height << ", "
+             << (style == LEVEL_STYLE_COUNT ? "mixed" : LEVEL_STYLE_NAMES[style]) << ", density " << density
+             << ") on " << pool.size() << " threads (seed " << baseSeed << ")" << endl;
+        cout << "Rejected attempts: " << totalRejected << endl;
+        cout << "Mean wall fraction: " << (pack.empty() ? 0.0 : wallFraction / pack.size()) << endl;
+        cout << "Elapsed: " << seconds << " s" << endl;
+        cout << "Levels/sec: " << (long long)(seconds > 0 ? pack.size() / seconds : 0) << endl;
+
+        if (!pack.save(path))
+        {
+            cerr << "Cannot write level pack: " << path << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// ============ Microbenchmarks ============
+struct BenchResult
+{
+    string name;
+    int width;
+    int height;
+    int length; // Snake length, 0 when not relevant
+    double fill; // Fraction of the board blocked, 0 when not relevant
+    long long iterations;
+    double nsPerOp;
+};
+
+class MicroBenchmarks
+{
+private:
+    vector<BenchResult> results;
+    volatile long long sink; // Keeps measured results observable
+
+    // Doubles the iteration count until a run takes long enough to trust
+    template <typename Fn>
+    static double measure(Fn fn, long long &iterations)
+    {
+        iterations = 1;
+        while (true)
+        {
+            auto start = chrono::steady_clock::now();
+            fn(iterations);
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            if (ns > 1e8 || iterations >= (1LL << 32))
+                return ns / iterations;
+            iterations *= 2;
+        }
+    }
+
+    // Like measure, but fn times only the region of interest and returns its ns
+    template <typename Fn>
+    static double measureRegion(Fn fn, long long &iterations)
+    {
+        iterations = 1;
+        while (true)
+        {
+            double ns = fn(iterations);
+            if (ns > 1e8 || iterations >= (1LL << 32))
+                return ns / iterations;
+            iterations *= 2;
+        }
+    }
+
+    void record(const string &name, int width, int height, int length, double fill, long long iterations,
+                double nsPerOp)
+    {
+        BenchResult r = {name, width, height, length, fill, iterations, nsPerOp};
+        results.push_back(r);
+    }
+
+    // Direction along a Hamiltonian cycle of a board with even height: serpentine
+    // rows over columns 1.., returning up column 0
+    static Point cycleDirection(const Point &p, int width, int height)
+    {
+        if (p.x == 0)
+            return p.y == 0 ? Point(1, 0) : Point(0, -1);
+        if (p.y % 2 == 0)
+            return p.x < width - 1 ? Point(1, 0) : Point(0, 1);
+        if (p.x > 1 || p.y == height - 1)
+            return Point(-1, 0);
+        return Point(0, 1);
+    }
+
+    static char directionKey(const Point &d)
+    {
+        if (d.x == 1)
+            return 'd';
+        if (d.x == -1)
+            return 'a';
+        return d.y == 1 ? 's' : 'w';
+    }
+
+    static void stepAlongCycle(Snake &snake, int width, int height)
+    {
+        Point d = cycleDirection(snake.getHead(), width, height);
+        snake.setDirection(d.x, d.y);
+        snake.move();
+    }
+
+    void benchSnake(int width, int height, int length)
+    {
+        Board board;
+        board.reset(width, height);
+        Snake snake(board, 2, 0);
+        while ((int)snake.getBody().size() < length)
+        {
+            snake.grow();
+            stepAlongCycle(snake, width, height);
+        }
+
+        long long iterations;
+        double ns = measure([&](long long n) {
+            for (long long i = 0; i < n; ++i)
+                stepAlongCycle(snake, width, height);
+        }, iterations);
+        record("Snake::move", width, height, length, 0, iterations, ns);
+
+        ns = measure([&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; ++i)
+                hits += snake.checkSelfCollision();
+            sink = hits;
+        }, iterations);
+        record("Snake::checkSelfCollision", width, height, length, 0, iterations, ns);
+    }
+
+    void benchObstacles(int width, int height)
+    {
+        Board board;
+        board.reset(width, height);
+        Rng rng(1);
+        Obstacle obstacles(board);
+        obstacles.generateObstacles(rng, Point(width / 2, height / 2));
+
+        vector<Point> probes(4096);
+        for (auto &p : probes)
+            p = Point(rng.uniform(width), rng.uniform(height));
+
+        long long iterations;
+        double ns = measure([&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; ++i)
+                hits += obstacles.isObstacle(probes[i & 4095]);
+            sink = hits;
+        }, iterations);
+        record("Obstacle::isObstacle", width, height, 0, 0, iterations, ns);
+    }
+
+    void benchSpawn(int width, int height, double fill)
+    {
+        Board board;
+        board.reset(width, height);
+        Rng rng(2);
+        Point cell;
+        int blocked = (int)(fill * width * height);
+        for (int i = 0; i < blocked && board.randomFreeCell(rng, cell); ++i)
+            board.set(cell, CELL_OBSTACLE);
+
+        FoodManager food(board, 1);
+        long long iterations;
+        double ns = measure([&](long long n) {
+            for (long long i = 0; i < n; ++i)
+            {
+                food.spawnFood(rng);
+                food.checkAndRemoveFood(food.getFoodPositions()[0]);
+            }
+        }, iterations);
+        record("FoodManager::spawnFood", width, height, 0, fill, iterations, ns);
+    }
+
+    // Flood fill from varying heads over a board one fifth obstacles; sizes that
+    // fit a fixed Bitboard also report the generic fill for comparison
+    void benchReachability(int width, int height, bool specialized)
+    {
+        Board board;
+        board.reset(width, height);
+        Rng rng(4);
+        Point cell;
+        for (int i = 0; i < width * height / 5 && board.randomFreeCell(rng, cell); ++i)
+            board.set(cell, CELL_OBSTACLE);
+
+        ReachabilityMap reach;
+        reach.setSpecialized(specialized);
+        long long iterations;
+        double ns = measure([&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; ++i)
+            {
+                reach.compute(board, Point(i % width, (i / width) % height));
+                hits += reach.isValid();
+            }
+            sink = hits;
+        }, iterations);
+        record(specialized ? "ReachabilityMap::compute" : "ReachabilityMap::compute (generic)", width, height, 0, 0.2,
+               iterations, ns);
+    }
+
+    // Frames go to /dev/null; the engine steps along the board cycle between
+    // frames so every draw has real changes to diff and send. Only draw() is
+    // timed: steps, resets and the full repaint after a reset are not.
+    void benchRender(int width, int height, int nullFd)
+    {
+        Game game(3);
+        game.WIDTH = width;
+        game.HEIGHT = height;
+        game.engine.reset(width, height);
+        game.viewWidth = width;
+        game.viewHeight = height;
+        game.cameraX = game.cameraY = 0;
+        game.lastHead = game.engine.getSnake().getHead();
+        game.initializeBuffer();
+        game.renderer.setOutput(nullFd);
+        game.renderer.reset(game.screenBuffer.size());
+
+        long long iterations;
+        double ns = measure([&](long long n) {
+            for (long long i = 0; i < n; ++i)
+                game.updateBuffer();
+        }, iterations);
+        record("Game::updateBuffer", width, height, 3, 0, iterations, ns);
+
+        ns = measureRegion([&](long long n) {
+            double timed = 0;
+            for (long long i = 0; i < n; ++i)
+            {
+                if (game.engine.isGameOver())
+                {
+                    game.engine.reset(width, height);
+                    game.draw();
+                }
+                Point d = cycleDirection(game.engine.getSnake().getHead(), width, height);
+                game.engine.step(directionKey(d));
+                auto start = chrono::steady_clock::now();
+                game.draw();
+                timed += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            }
+            return timed;
+        }, iterations);
+        record("Game::draw", width, height, 0, 0, iterations, ns);
+    }
+
+public:
+    MicroBenchmarks() : sink(0) {}
+
+    void run()
+    {
+        static const int sizes[][2] = {{40, 24}, {256, 256}, {1024, 1024}};
+        static const int lengths[] = {3, 256, 4096, 65536};
+        static const double fills[] = {0.0, 0.5, 0.9, 0.99};
+
+        for (const auto &size : sizes)
+        {
+            for (int length : lengths)
+            {
+                if (length < size[0] * size[1] - size[1])
+                    benchSnake(size[0], size[1], length);
+            }
+            benchObstacles(size[0], size[1]);
+            for (double fill : fills)
+                benchSpawn(size[0], size[1], fill);
+        }
+
+        static const int floodSizes[][2] = {{40, 25}, {60, 30}, {256, 256}};
+        for (const auto &size : floodSizes)
+        {
+            benchReachability(size[0], size[1], true);
+            if (size[0] <= 64 && size[1] <= 64)
+                benchReachability(size[0], size[1], false);
+        }
+
+        int nullFd = open("/dev/null", O_WRONLY);
+        static const int renderSizes[][2] = {{40, 24}, {60, 30}, {200, 100}};
+        for (const auto &size : renderSizes)
+            benchRender(size[0], size[1], nullFd);
+        close(nullFd);
+    }
+
+    void printCsv() const
+    {
+        cout << "benchmark,width,height,snake_length,fill,iterations,ns_per_op" << endl;
+        for (const auto &r : results)
+        {
+            cout << r.name << "," << r.width << "," << r.height << "," << r.length << ","
+                 << r.fill << "," << r.iterations << "," << r.nsPerOp << endl;
+        }
+    }
+
+    void printJson() const
+    {
+        cout << "[" << endl;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchResult &r = results[i];
+            cout << "  {\"benchmark\": \"" << r.name << "\", \"width\": " << r.width
+                 << ", \"height\": " << r.height << ", \"snake_length\": " << r.length
+                 << ", \"fill\": " << r.fill << ", \"iterations\": " << r.iterations
+                 << ", \"ns_per_op\": " << r.nsPerOp << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        cout << "]" << endl;
+    }
+};
+
+// ============ Multiplayer Server ============
+// One authoritative world shared by every connected snake. All snakes register
+// on the same Board, so its per-cell segment counts double as the spatial index
+// for snake-vs-snake collisions: after everyone moves, a head whose cell holds
+// more than one segment ran into a snake (its own or another's).
+struct Player
+{
+    Snake *snake; // nullptr while waiting to respawn
+    int score;
+    int respawnTimer;
+    int invincibilityTimer; // Effects are active while their timer is positive
+    int doubleScoreTimer;
+
+    static const int MAX_PENDING_TURNS = 4;
+    Point pendingTurns[MAX_PENDING_TURNS];
+    int pendingTurnCount;
+
+    Player() : snake(nullptr), score(0), respawnTimer(0), invincibilityTimer(0), doubleScoreTimer(0),
+               pendingTurnCount(0) {}
+};
+
+class World
+{
+private:
+    int width;
+    int height;
+    Board board;
+    Rng rng;
+    FoodManager foodManager;
+    Obstacle obstacles;
+    ReachabilityMap reachability;
+    vector<PowerUp> powerups;
+    vector<Player *> players;
+    vector<Player *> crashed; // Scratch list reused every tick
+    long long tickCounter;
+
+    static const int RESPAWN_TICKS = 25;
+
+    // New snakes face right, so they need their body cells plus a few cells of
+    // clear run-up ahead
+    bool spawnSnake(Player &player)
+    {
+        for (int attempt = 0; attempt < 64; ++attempt)
+        {
+            Point head;
+            if (!board.randomFreeCell(rng, head))
+                return false;
+            bool clear = true;
+            for (int dx = -2; dx <= 3 && clear; ++dx)
+                clear = board.isFree(Point(head.x + dx, head.y));
+            if (clear)
+            {
+                player.snake = new Snake(board, head.x, head.y, 64);
+                player.pendingTurnCount = 0;
+                player.invincibilityTimer = 0;
+                player.doubleScoreTimer = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void removeSnake(Player &player)
+    {
+        if (!player.snake)
+            return;
+        player.snake->getBody().forEach([this](const Point &segment) { board.removeSnake(segment); });
+        board.removeHead(player.snake->getHead());
+        delete player.snake;
+        player.snake = nullptr;
+    }
+
+    void applyPendingTurn(Player &player)
+    {
+        int used = 0;
+        bool turned = false;
+        while (used < player.pendingTurnCount && !turned)
+        {
+            turned = player.snake->setDirection(player.pendingTurns[used].x, player.pendingTurns[used].y);
+            used++;
+        }
+        for (int i = used; i < player.pendingTurnCount; ++i)
+            player.pendingTurns[i - used] = player.pendingTurns[i];
+        player.pendingTurnCount -= used;
+    }
+
+    bool crashedThisTick(const Player &player) const
+    {
+        if (player.invincibilityTimer > 0)
+            return false;
+        Point head = player.snake->getHead();
+        return !board.inBounds(head) || board.has(head, CELL_OBSTACLE) || board.snakeAt(head) > 1;
+    }
+
+    // New food goes where the eater can reach it; if snakes have boxed it in
+    // completely, anywhere free so the board doesn't run out of food
+    void checkFood(Player &player)
+    {
+        if (foodManager.checkAndRemoveFood(player.snake->getHead()))
+        {
+            player.snake->grow();
+            player.score += player.doubleScoreTimer > 0 ? 2 : 1;
+            reachability.prepare(board, player.snake->getHead());
+            if (!foodManager.spawnFood(rng, &reachability))
+                foodManager.spawnFood(rng);
+        }
+    }
+
+    // Speed powerups change a single player's tick rate, which a shared world
+    // can't do; they are still collected so they don't block the board
+    void checkPowerUp(Player &player)
+    {
+        Point head = player.snake->getHead();
+        if (!board.has(head, CELL_POWERUP))
+            return;
+
+        for (auto &powerup : powerups)
+        {
+            if (powerup.isActive() && head == powerup.getPosition())
+            {
+                switch (powerup.getType())
+                {
+                case SCORE_DOUBLE:
+                    player.doubleScoreTimer = 100;
+                    break;
+                case INVINCIBILITY:
+                    player.invincibilityTimer = 100;
+                    break;
+                case SHRINK:
+                    player.snake->shrink();
+                    break;
+                default:
+                    break;
+                }
+                powerup.deactivate(board);
+                break;
+            }
+        }
+    }
+
+public:
+    World(int gridWidth, int gridHeight, uint64_t seed)
+        : width(gridWidth), height(gridHeight), foodManager(board, max(3, gridWidth * gridHeight / 200)),
+          obstacles(board), tickCounter(0)
+    {
+        rng.reseed(seed);
+        board.reset(width, height);
+        obstacles.generateObstacles(rng, Point(width / 2, height / 2), reachability);
+        foodManager.initializeFoods(rng, &reachability);
+    }
+
+    ~World()
+    {
+        for (size_t i = 0; i < players.size(); ++i)
+        {
+            removeSnake(*players[i]);
+            delete players[i];
+        }
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const Board &getBoard() const { return board; }
+    const vector<PowerUp> &getPowerUps() const { return powerups; }
+    const vector<Player *> &getPlayers() const { return players; }
+    long long getTicks() const { return tickCounter; }
+
+    // A player whose snake finds no room yet spawns later, like after a crash
+    Player *addPlayer()
+    {
+        Player *player = new Player();
+        if (!spawnSnake(*player))
+            player->respawnTimer = RESPAWN_TICKS;
+        players.push_back(player);
+        return player;
+    }
+
+    void removePlayer(Player *player)
+    {
+        removeSnake(*player);
+        players.erase(find(players.begin(), players.end(), player));
+        delete player;
+    }
+
+    void queueInput(Player &player, char input)
+    {
+        Point turn;
+        switch (input)
+        {
+        case 'w':
+        case 'W':
+            turn = Point(0, -1);
+            break;
+        case 's':
+        case 'S':
+            turn = Point(0, 1);
+            break;
+        case 'a':
+        case 'A':
+            turn = Point(-1, 0);
+            break;
+        case 'd':
+        case 'D':
+            turn = Point(1, 0);
+            break;
+        default:
+            return;
+        }
+
+        if (player.pendingTurnCount < Player::MAX_PENDING_TURNS)
+            player.pendingTurns[player.pendingTurnCount++] = turn;
+    }
+
+    // Every snake moves before any collision is judged, so a tail leaving a
+    // cell this tick never kills the head entering it
+    void step()
+    {
+        tickCounter++;
+
+        for (size_t i = 0; i < players.size(); ++i)
+        {
+            Player &player = *players[i];
+            if (!player.snake)
+                continue;
+            applyPendingTurn(player);
+            player.snake->move();
+        }
+
+        crashed.clear();
+        for (size_t i = 0; i < players.size(); ++i)
+        {
+            if (players[i]->snake && crashedThisTick(*players[i]))
+                crashed.push_back(players[i]);
+        }
+        for (size_t i = 0; i < crashed.size(); ++i)
+        {
+            removeSnake(*crashed[i]);
+            crashed[i]->score = 0;
+            crashed[i]->respawnTimer = RESPAWN_TICKS;
+        }
+
+        for (size_t i = 0; i < players.size(); ++i)
+        {
+            Player &player = *players[i];
+            if (!player.snake)
+            {
+                if (--player.respawnTimer <= 0 && !spawnSnake(player))
+                    player.respawnTimer = RESPAWN_TICKS;
+                continue;
+            }
+            checkFood(player);
+            checkPowerUp(player);
+            if (player.invincibilityTimer > 0)
+                player.invincibilityTimer--;
+            if (player.doubleScoreTimer > 0)
+                player.doubleScoreTimer--;
+        }
+
+        // Spawn new powerup periodically, more of them with more players
+        if (tickCounter % 150 == 0)
+        {
+            PowerUp pu;
+            if (pu.spawn(board, rng))
+                powerups.push_back(pu);
+
+            size_t maxPowerUps = max<size_t>(3, players.size() / 4);
+            while (powerups.size() > maxPowerUps)
+            {
+                powerups.front().deactivate(board);
+                powerups.erase(powerups.begin());
+            }
+        }
+    }
+
+    // Text rows for one player's view, centred on their snake: their own snake
+    // as O/o, everyone else's as X/x
+    void renderView(const Player &viewer, int viewWidth, int viewHeight, string &out) const
+    {
+        viewWidth = min(viewWidth, width);
+        viewHeight = min(viewHeight, height);
+        Point centre = viewer.snake ? viewer.snake->getHead() : Point(width / 2, height / 2);
+        int cameraX = max(0, min(centre.x - viewWidth / 2, width - viewWidth));
+        int cameraY = max(0, min(centre.y - viewHeight / 2, height - viewHeight));
+
+        size_t rowLength = viewWidth + 3; // Borders and newline
+        size_t start = out.size();
+        out.append("+").append(viewWidth, '-').append("+\n");
+        for (int y = 0; y < viewHeight; ++y)
+        {
+            out += '|';
+            for (int x = 0; x < viewWidth; ++x)
+            {
+                Point p(cameraX + x, cameraY + y);
+                char c = ' ';
+                if (board.headAt(p))
+                    c = 'X';
+                else if (board.snakeAt(p) > 0)
+                    c = 'x';
+                else if (board.has(p, CELL_POWERUP))
+                    c = 'P';
+                else if (board.has(p, CELL_FOOD))
+                    c = '*';
+                else if (board.has(p, CELL_OBSTACLE))
+                    c = '#';
+                out += c;
+            }
+            out += "|\n";
+        }
+        out.append("+").append(viewWidth, '-').append("+\n");
+
+        auto cell = [&](const Point &p) -> char * {
+            int vx = p.x - cameraX;
+            int vy = p.y - cameraY;
+            if (vx < 0 || vx >= viewWidth || vy < 0 || vy >= viewHeight)
+                return nullptr;
+            return &out[start + (vy + 1) * rowLength + vx + 1];
+        };
+        for (const auto &powerup : powerups)
+        {
+            char *c = powerup.isActive() ? cell(powerup.getPosition()) : nullptr;
+            if (c && !board.headAt(powerup.getPosition()))
+                *c = powerup.getSymbol();
+        }
+        if (viewer.snake)
+        {
+            char symbol = 'O';
+            viewer.snake->getBody().forEach([&](const Point &segment) {
+                char *c = cell(segment);
+                if (c)
+                    *c = symbol;
+                symbol = 'o';
+            });
+        }
+
+        // Formatted on the stack straight into the connection's reused buffer
+        char line[128];
+        int n = snprintf(line, sizeof(line), "Score: %d | Players: %zu", viewer.score, players.size());
+        if (viewer.snake)
+            n += snprintf(line + n, sizeof(line) - n, " | Length: %zu", viewer.snake->getBody().size());
+        out.append(line, n).append("\n");
+
+        if (!viewer.snake)
+            n = snprintf(line, sizeof(line), "Crashed! Respawning in %d ticks", viewer.respawnTimer);
+        else if (viewer.invincibilityTimer > 0 || viewer.doubleScoreTimer > 0)
+        {
+            n = snprintf(line, sizeof(line), "Active Effects: ");
+            if (viewer.invincibilityTimer > 0)
+                n += snprintf(line + n, sizeof(line) - n, "[INVINCIBLE:%d] ", viewer.invincibilityTimer);
+            if (viewer.doubleScoreTimer > 0)
+                n += snprintf(line + n, sizeof(line) - n, "[DOUBLE SCORE:%d] ", viewer.doubleScoreTimer);
+        }
+        else
+            n = snprintf(line, sizeof(line), "Active Effects: None");
+        out.append(line, n).append("\nControls: W/A/S/D or Arrow Keys | Q to quit");
+    }
+};
+
+static volatile sig_atomic_t serverStopRequested = 0;
+
+static void requestServerStop(int)
+{
+    serverStopRequested = 1;
+}
+
+// Wire format. Client to server: key bytes as typed, plus NET_RESIZE followed
+// by the terminal's columns and rows as little-endian u16s. Server to client:
+// frames of [u32 length, little endian][rows separated by '\n'].
+static const unsigned char NET_RESIZE = 1;
+
+class GameServer
+{
+private:
+    struct Connection
+    {
+        int fd;
+        Player *player;
+        string out;    // Unsent bytes of the latest frame
+        size_t outPos;
+        bool writeArmed; // EPOLLOUT registered
+        int viewWidth;
+        int viewHeight;
+        unsigned char resize[4];
+        int resizeBytes; // -1 outside a resize message
+
+        Connection(int fd, Player *player)
+            : fd(fd), player(player), outPos(0), writeArmed(false), viewWidth(40), viewHeight(20),
+              resizeBytes(-1) {}
+    };
+
+    World world;
+    string path;
+    int listenFd;
+    int epollFd;
+    int timerFd;
+    int spareFd; // Held back so a connection can still be accepted and refused at the fd limit
+    long long periodNs;
+    vector<Connection *> connections; // Indexed by fd
+    vector<long long> closedInBatch;  // Per fd, the epoll_wait batch that last closed it
+    long long batch;
+    size_t connectionCount;
+    size_t peakConnections;
+    long long framesSent;
+    long long framesSkipped;
+    long long refusedConnections;
+
+    static void raiseFileLimit()
+    {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    void watch(int fd, uint32_t events, int op)
+    {
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, op, fd, &ev);
+    }
+
+    void acceptAll()
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if ((errno == EMFILE || errno == ENFILE) && spareFd >= 0)
+                {
+                    // The listen fd is level-triggered, so a pending connection
+                    // left in the backlog would wake epoll_wait forever. accept
+                    // reports EMFILE even with an empty backlog, so stop once the
+                    // spare slot finds nothing to refuse.
+                    close(spareFd);
+                    fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd >= 0)
+                    {
+                        close(fd);
+                        refusedConnections++;
+                    }
+                    spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    if (fd >= 0)
+                        continue;
+                }
+                return; // EAGAIN once the backlog is drained
+            }
+            if ((size_t)fd >= connections.size())
+            {
+                connections.resize(fd + 1, nullptr);
+                closedInBatch.resize(fd + 1, -1);
+            }
+            connections[fd] = new Connection(fd, world.addPlayer());
+            watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+            connectionCount++;
+            peakConnections = max(peakConnections, connectionCount);
+        }
+    }
+
+    void disconnect(Connection *conn)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        world.removePlayer(conn->player);
+        connections[conn->fd] = nullptr;
+        closedInBatch[conn->fd] = batch;
+        connectionCount--;
+        delete conn;
+    }
+
+    // Returns false when the client went away
+    bool readInput(Connection *conn)
+    {
+        unsigned char buffer[256];
+        while (true)
+        {
+            ssize_t n = read(conn->fd, buffer, sizeof(buffer));
+            if (n == 0)
+                return false;
+            if (n < 0)
+                return errno == EAGAIN || errno == EINTR;
+
+            for (ssize_t i = 0; i < n; ++i)
+            {
+                unsigned char c = buffer[i];
+                if (conn->resizeBytes >= 0)
+                {
+                    conn->resize[conn->resizeBytes++] = c;
+                    if (conn->resizeBytes == 4)
+                    {
+                        int cols = conn->resize[0] | conn->resize[1] << 8;
+                        int rows = conn->resize[2] | conn->resize[3] << 8;
+                        conn->viewWidth = max(10, min(cols - 2, 1000));
+                        conn->viewHeight = max(5, min(rows - 6, 1000));
+                        conn->resizeBytes = -1;
+                    }
+                }
+                else if (c == NET_RESIZE)
+                    conn->resizeBytes = 0;
+                else if (c == 'q' || c == 'Q')
+                    return false;
+                else
+                    world.queueInput(*conn->player, c);
+            }
+        }
+    }
+
+    // Returns false on a write error
+    bool flush(Connection *conn)
+    {
+        while (conn->outPos < conn->out.size())
+        {
+            ssize_t n = send(conn->fd, conn->out.data() + conn->outPos, conn->out.size() - conn->outPos,
+                             MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                    return false;
+                if (!conn->writeArmed)
+                {
+                    watch(conn->fd, EPOLLIN | EPOLLRDHUP | EPOLLOUT, EPOLL_CTL_MOD);
+                    conn->writeArmed = true;
+                }
+                return true;
             }
+            conn->outPos += n;
+        }
+        conn->out.clear();
+        conn->outPos = 0;
+        if (conn->writeArmed)
+        {
+            watch(conn->fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+            conn->writeArmed = false;
         }
+        return true;
+    }
 
-        // Update double score
-        if (doubleScoreActive)
+    // Frames are complete snapshots, so a client still draining the previous
+    // one simply skips this tick instead of queueing a backlog
+    void broadcast()
+    {
+        for (size_t fd = 0; fd < connections.size(); ++fd)
         {
-            doubleScoreTimer--;
-            if (doubleScoreTimer <= 0)
+            Connection *conn = connections[fd];
+            if (!conn)
+                continue;
+            if (!conn->out.empty())
             {
-                doubleScoreActive = false;
+                framesSkipped++;
+                continue;
             }
+
+            conn->out.assign(4, '\0');
+            world.renderView(*conn->player, conn->viewWidth, conn->viewHeight, conn->out);
+            uint32_t length = conn->out.size() - 4;
+            for (int i = 0; i < 4; ++i)
+                conn->out[i] = (char)(length >> (8 * i));
+            framesSent++;
+            if (!flush(conn))
+                disconnect(conn);
         }
+    }
 
-        // Reset speed if no speed powerup active
-        bool hasSpeedPowerup = false;
-        for (const auto &pu : powerups)
+public:
+    GameServer(const string &path, int width, int height, uint64_t seed)
+        : world(width, height, seed), path(path), listenFd(-1), epollFd(-1), timerFd(-1), spareFd(-1),
+          periodNs(120000000LL), batch(0), connectionCount(0), peakConnections(0), framesSent(0),
+          framesSkipped(0), refusedConnections(0) {}
+
+    ~GameServer()
+    {
+        for (size_t fd = 0; fd < connections.size(); ++fd)
         {
-            if (pu.getRemainingTime() > 0)
-            {
-                hasSpeedPowerup = true;
-                break;
-            }
+            if (connections[fd])
+                disconnect(connections[fd]);
         }
-        if (!hasSpeedPowerup)
+        if (listenFd >= 0)
         {
-            currentSpeed = baseSpeed;
+            close(listenFd);
+            unlink(path.c_str());
         }
+        if (epollFd >= 0)
+            close(epollFd);
+        if (timerFd >= 0)
+            close(timerFd);
+        if (spareFd >= 0)
+            close(spareFd);
     }
 
-public:
-    Game() : WIDTH(40), HEIGHT(25), snake(nullptr), foodManager(3), score(0),
-             baseSpeed(120000), currentSpeed(120000), gameOver(false),
-             invincibilityActive(false), doubleScoreActive(false),
-             invincibilityTimer(0), doubleScoreTimer(0) {}
-
-    ~Game()
+    bool open()
     {
-        if (snake)
-            delete snake;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            cerr << "Socket path too long: " << path << endl;
+            return false;
+        }
+        strcpy(addr.sun_path, path.c_str());
+
+        raiseFileLimit();
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(path.c_str()); // Stale socket from a server that didn't shut down cleanly
+        if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0)
+        {
+            cerr << "Cannot listen on " << path << ": " << strerror(errno) << endl;
+            return false;
+        }
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (epollFd < 0 || timerFd < 0)
+        {
+            cerr << "Cannot create epoll/timerfd: " << strerror(errno) << endl;
+            return false;
+        }
+
+        struct itimerspec spec;
+        spec.it_interval.tv_sec = periodNs / 1000000000LL;
+        spec.it_interval.tv_nsec = periodNs % 1000000000LL;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(timerFd, 0, &spec, nullptr);
+
+        watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(timerFd, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
     }
 
+    // Serve until SIGINT/SIGTERM
     void run()
     {
-        srand(time(0));
-        setupTerminal();
-        hideCursor();
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = requestServerStop; // No SA_RESTART: epoll_wait returns EINTR
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
 
-        bool running = true;
+        cout << "Serving a " << world.getWidth() << "x" << world.getHeight() << " board on " << path << endl;
 
-        while (running)
+        const int maxEvents = 256;
+        struct epoll_event events[maxEvents];
+        while (!serverStopRequested)
         {
-            getTerminalSize();
+            int n = epoll_wait(epollFd, events, maxEvents, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            batch++;
 
-            if (snake)
-                delete snake;
-            snake = new Snake(WIDTH / 2, HEIGHT / 2);
-            score = 0;
-            gameOver = false;
-            currentSpeed = baseSpeed;
-            invincibilityActive = false;
-            doubleScoreActive = false;
-            powerups.clear();
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == listenFd)
+                {
+                    acceptAll();
+                }
+                else if (fd == timerFd)
+                {
+                    // Catch up at most three missed ticks, then broadcast once
+                    uint64_t expirations = 0;
+                    if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    {
+                        for (uint64_t t = 0; t < min<uint64_t>(expirations, 3); ++t)
+                            world.step();
+                        broadcast();
+                    }
+                }
+                else if ((size_t)fd < connections.size() && connections[fd] && closedInBatch[fd] != batch)
+                {
+                    // A connection closed earlier in this batch may already have
+                    // handed its fd to a new one, which must not get the old events
+                    Connection *conn = connections[fd];
+                    bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                    if (alive && (events[i].events & (EPOLLIN | EPOLLRDHUP)))
+                        alive = readInput(conn);
+                    if (alive && (events[i].events & EPOLLOUT))
+                        alive = flush(conn);
+                    if (!alive)
+                        disconnect(conn);
+                }
+            }
+        }
+
+        cout << endl << "Ticks: " << world.getTicks() << " | Peak players: " << peakConnections
+             << " | Frames sent: " << framesSent << " | Skipped for slow clients: " << framesSkipped
+             << " | Refused at fd limit: " << refusedConnections << endl;
+    }
+};
 
-            obstacles.generateObstacles(WIDTH, HEIGHT, Point(WIDTH / 2, HEIGHT / 2));
-            foodManager.initializeFoods(WIDTH, HEIGHT, snake->getBody(), obstacles, powerups);
+// ============ Multiplayer Client ============
+// Thin terminal front end: forwards keys and draws the server's frames with
+// the same TerminalRenderer as local play
+class MultiplayerClient
+{
+private:
+    int fd;
+    InputThread input;
+    TerminalRenderer renderer;
+    struct termios oldt;
 
-            // Spawn initial powerups
-            for (int i = 0; i < 2; ++i)
+    bool sendAll(const unsigned char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+            if (n < 0)
             {
-                PowerUp pu;
-                pu.spawn(WIDTH, HEIGHT, snake->getBody(), obstacles.getPositions(),
-                         foodManager.getFoodPositions());
-                powerups.push_back(pu);
+                if (errno == EINTR)
+                    continue;
+                return false;
             }
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
 
-            // Show instructions
-            clearScreen();
-            cout << "=== SNAKE GAME - ENHANCED EDITION ===" << endl;
-            cout << "Controls: W/A/S/D or Arrow Keys" << endl;
-            cout << "Goal: Eat food (*) and collect powerups!" << endl;
-            cout << "\nPowerups:" << endl;
-            cout << "  S - Speed Boost (faster movement)" << endl;
-            cout << "  L - Slow Motion (easier control)" << endl;
-            cout << "  D - Double Score (2x points)" << endl;
-            cout << "  I - Invincibility (can't die)" << endl;
-            cout << "  R - Shrink (remove tail segment)" << endl;
-            cout << "\nAvoid walls (#), obstacles, and yourself!" << endl;
-            cout << "Play Area: " << WIDTH << "x" << HEIGHT << endl;
-            cout << "Current High Score: " << highScoreManager.getHighScore() << endl;
-            cout << "\nPress any key to start..." << endl;
+    bool sendSize()
+    {
+        struct winsize w = {};
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+        unsigned char message[5] = {NET_RESIZE, (unsigned char)w.ws_col, (unsigned char)(w.ws_col >> 8),
+                                    (unsigned char)w.ws_row, (unsigned char)(w.ws_row >> 8)};
+        return sendAll(message, sizeof(message));
+    }
 
-            while (getInput() == 0)
+    static void splitRows(const char *data, size_t length, vector<string> &rows)
+    {
+        rows.clear();
+        size_t start = 0;
+        for (size_t i = 0; i <= length; ++i)
+        {
+            if (i == length || data[i] == '\n')
             {
-                usleep(10000);
+                rows.push_back(string(data + start, i - start));
+                start = i + 1;
             }
+        }
+    }
 
-            initializeBuffer();
-            drawFullScreen();
+public:
+    MultiplayerClient() : fd(-1) {}
 
-            int tickCounter = 0;
+    ~MultiplayerClient()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
 
-            // Game loop
-            while (!gameOver)
+    bool connectTo(const string &path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            cerr << "Socket path too long: " << path << endl;
+            return false;
+        }
+        strcpy(addr.sun_path, path.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            cerr << "Cannot connect to " << path << ": " << strerror(errno) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    void run()
+    {
+        tcgetattr(STDIN_FILENO, &oldt);
+        struct termios newt = oldt;
+        newt.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+        cout << "\033[?25l";
+        cout.flush();
+        input.start();
+
+        string inbox;
+        vector<string> frame;
+        size_t shownRows = 0;
+        bool connected = sendSize();
+        while (connected)
+        {
+            struct pollfd fds[2];
+            fds[0].fd = fd;
+            fds[0].events = POLLIN;
+            fds[1].fd = input.getNotifyFd();
+            fds[1].events = POLLIN;
+            if (::poll(fds, 2, -1) < 0)
             {
-                draw();
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
 
-                char input = getInput();
-                if (input != 0)
+            if (fds[1].revents & POLLIN)
+            {
+                input.clearNotify();
+                char key;
+                while (connected && input.tryGetKey(key))
                 {
-                    processInput(input);
+                    unsigned char byte = key;
+                    connected = sendAll(&byte, 1) && key != 'q' && key != 'Q';
                 }
+            }
 
-                snake->move();
-
-                if (checkCollision())
+            if (connected && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                char buffer[65536];
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n <= 0)
                 {
-                    gameOver = true;
-                    SoundManager::playSound("gameover");
+                    connected = n < 0 && errno == EINTR;
+                    continue;
                 }
+                inbox.append(buffer, n);
 
-                checkFood();
-                checkPowerUp();
-                updatePowerUpEffects();
-
-                // Spawn new powerup periodically
-                tickCounter++;
-                if (tickCounter % 150 == 0)
+                // Draw only the newest complete frame
+                size_t pos = 0;
+                size_t latest = string::npos;
+                uint32_t latestLength = 0;
+                while (inbox.size() - pos >= 4)
                 {
-                    PowerUp pu;
-                    pu.spawn(WIDTH, HEIGHT, snake->getBody(), obstacles.getPositions(),
-                             foodManager.getFoodPositions());
-                    powerups.push_back(pu);
-
-                    // Keep maximum 3 powerups
-                    if (powerups.size() > 3)
+                    uint32_t length = 0;
+                    for (int i = 0; i < 4; ++i)
+                        length |= (uint32_t)(unsigned char)inbox[pos + i] << (8 * i);
+                    if (inbox.size() - pos - 4 < length)
+                        break;
+                    latest = pos + 4;
+                    latestLength = length;
+                    pos += 4 + length;
+                }
+                if (latest != string::npos)
+                {
+                    splitRows(inbox.data() + latest, latestLength, frame);
+                    if (frame.size() != shownRows)
                     {
-                        powerups.erase(powerups.begin());
+                        renderer.reset(frame.size());
+                        shownRows = frame.size();
                     }
+                    renderer.present(frame);
                 }
-
-                usleep(currentSpeed);
+                inbox.erase(0, pos);
             }
+        }
+
+        input.stop();
+        tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+        cout << "\033[?25h\033[2J\033[H" << "Disconnected." << endl;
+    }
+};
 
-            highScoreManager.saveHighScore(score);
+static void printUsage(const char *prog)
+{
+    cout << "Usage: " << prog << " [options]" << endl;
+    cout << "  --headless N     Run N ticks without the terminal and report ticks/sec" << endl;
+    cout << "  --size WxH       Board size, up to 8192x8192 (default 40x25 headless, terminal-sized" << endl;
+    cout << "                   interactive); boards larger than the terminal scroll" << endl;
+    cout << "  --script FILE    Replay keys from FILE, one per tick ('.' = no input)" << endl;
+    cout << "  --batch N        Play N complete games in parallel and report distributions" << endl;
+    cout << "  --threads T      Worker threads for --batch (default: all cores)" << endl;
+    cout << "  --seed S         Seed for all game randomness (default: current time)" << endl;
+    cout << "  --record FILE    Record every game played to a replay file" << endl;
+    cout << "  --replay FILE    Play back a replay file at original speed" << endl;
+    cout << "  --fast           With --replay, re-simulate headlessly as fast as possible" << endl;
+    cout << "  --render-thread  Draw frames on a separate thread from the simulation" << endl;
+    cout << "  --save FILE      Q suspends the game to FILE (default snake_save.bin); with" << endl;
+    cout << "                   --headless, snapshot the final state" << endl;
+    cout << "  --resume FILE    Continue from a snapshot (interactive or --headless)" << endl;
+    cout << "  --make-levels N FILE" << endl;
+    cout << "                   Generate N validated levels in parallel (--size, --threads, --seed)" << endl;
+    cout << "                   and save them as a level pack" << endl;
+    cout << "  --style STYLE    Level layout: caves, maze, rooms or mixed (default mixed)" << endl;
+    cout << "  --density D      Fraction of cells walled in generated levels (default 0.2)" << endl;
+    cout << "  --levels FILE    Play levels from a pack instead of random obstacles" << endl;
+    cout << "  --scores         Print the leaderboard and exit" << endl;
+    cout << "  --bench [FORMAT] Run engine microbenchmarks, printed as csv (default) or json" << endl;
+    cout << "  --autopilot      Let the BFS bot play (interactive, --headless and --batch)" << endl;
+    cout << "  --serve SOCKET   Host a shared multiplayer board on a Unix socket (default 120x60)" << endl;
+    cout << "  --connect SOCKET Join a multiplayer server" << endl;
+    cout << "  --spectate SOCKET" << endl;
+    cout << "                   Let other terminals watch this game through SOCKET" << endl;
+    cout << "  --watch SOCKET   Watch a game started with --spectate" << endl;
+    cout << "  --profile        Per-phase tick latency histograms and heap allocation counts to stderr" << endl;
+    cout << "                   on exit and on SIGUSR1 (needs a build with -DSNAKE_PROFILE)" << endl;
+}
 
-            // Game over screen
-            clearScreen();
-            cout << "=== GAME OVER ===" << endl;
-            cout << "Final Score: " << score << endl;
-            cout << "High Score: " << highScoreManager.getHighScore() << endl;
-            if (score == highScoreManager.getHighScore() && score > 0)
+int main(int argc, char **argv)
+{
+    long long headlessTicks = 0;
+    long long batchGames = 0;
+    int threads = thread::hardware_concurrency();
+    uint64_t seed = time(0);
+    string recordPath;
+    string replayPath;
+    bool fastReplay = false;
+    bool renderThread = false;
+    string benchFormat;
+    bool profile = false;
+    bool autopilot = false;
+    bool showScores = false;
+    string servePath;
+    string connectPath;
+    string spectatePath;
+    string watchPath;
+    string resumePath;
+    string savePath;
+    long long levelCount = 0;
+    string levelOutPath;
+    string levelsPath;
+    int levelStyle = LEVEL_STYLE_COUNT;
+    double density = 0.2;
+    int width = 40;
+    int height = 25;
+    bool sizeGiven = false;
+    string script;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc)
+        {
+            headlessTicks = atoll(argv[++i]);
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batchGames = atoll(argv[++i]);
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (arg == "--fast")
+        {
+            fastReplay = true;
+        }
+        else if (arg == "--bench")
+        {
+            benchFormat = "csv";
+            if (i + 1 < argc && (string(argv[i + 1]) == "csv" || string(argv[i + 1]) == "json"))
+                benchFormat = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            servePath = argv[++i];
+        }
+        else if (arg == "--connect" && i + 1 < argc)
+        {
+            connectPath = argv[++i];
+        }
+        else if (arg == "--spectate" && i + 1 < argc)
+        {
+            spectatePath = argv[++i];
+        }
+        else if (arg == "--watch" && i + 1 < argc)
+        {
+            watchPath = argv[++i];
+        }
+        else if (arg == "--resume" && i + 1 < argc)
+        {
+            resumePath = argv[++i];
+        }
+        else if (arg == "--save" && i + 1 < argc)
+        {
+            savePath = argv[++i];
+        }
+        else if (arg == "--make-levels" && i + 2 < argc)
+        {
+            levelCount = atoll(argv[++i]);
+            levelOutPath = argv[++i];
+        }
+        else if (arg == "--style" && i + 1 < argc)
+        {
+            string name = argv[++i];
+            levelStyle = find(LEVEL_STYLE_NAMES, LEVEL_STYLE_NAMES + LEVEL_STYLE_COUNT, name) - LEVEL_STYLE_NAMES;
+            if (levelStyle == LEVEL_STYLE_COUNT && name != "mixed")
             {
-                cout << "🎉 NEW HIGH SCORE! 🎉" << endl;
+                cerr << "Unknown level style: " << name << endl;
+                return 1;
             }
-            cout << endl;
-            cout << "Press R to restart or Q to quit: ";
-            cout.flush();
-
-            char choice = 0;
-            while (choice != 'r' && choice != 'R' && choice != 'q' && choice != 'Q')
+        }
+        else if (arg == "--density" && i + 1 < argc)
+        {
+            density = atof(argv[++i]);
+            if (density <= 0 || density >= 0.75)
             {
-                choice = getInput();
-                usleep(10000);
+                cerr << "Density must be between 0 and 0.75: " << argv[i] << endl;
+                return 1;
             }
-
-            if (choice == 'q' || choice == 'Q')
+        }
+        else if (arg == "--levels" && i + 1 < argc)
+        {
+            levelsPath = argv[++i];
+        }
+        else if (arg == "--scores")
+        {
+            showScores = true;
+        }
+        else if (arg == "--autopilot")
+        {
+            autopilot = true;
+        }
+        else if (arg == "--profile")
+        {
+            profile = true;
+        }
+        else if (arg == "--render-thread")
+        {
+            renderThread = true;
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 5 || height < 5 ||
+                width > 8192 || height > 8192)
             {
-                running = false;
+                cerr << "Invalid board size: " << argv[i] << endl;
+                return 1;
             }
+            sizeGiven = true;
+        }
+        else if (arg == "--script" && i + 1 < argc)
+        {
+            ifstream file(argv[++i]);
+            if (!file.is_open())
+            {
+                cerr << "Cannot open script: " << argv[i] << endl;
+                return 1;
+            }
+            char c;
+            while (file.get(c))
+            {
+                if (c != '\n' && c != '\r')
+                    script += c;
+            }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
         }
+    }
 
-        showCursor();
-        restoreTerminal();
-        clearScreen();
-        cout << "Thanks for playing!" << endl;
-        cout << "Final High Score: " << highScoreManager.getHighScore() << endl;
+#ifdef SNAKE_PROFILE
+    if (profile)
+        signal(SIGUSR1, requestProfileDump);
+#else
+    if (profile)
+    {
+        cerr << "--profile needs a build with -DSNAKE_PROFILE" << endl;
+        return 1;
     }
-};
+#endif
 
-int main()
-{
-    Game game;
+    if (showScores)
+    {
+        Leaderboard leaderboard;
+        cout << "Games played: " << leaderboard.getTotalGames() << endl;
+        leaderboard.print(cout);
+        return 0;
+    }
+
+    if (!benchFormat.empty())
+    {
+        MicroBenchmarks bench;
+        bench.run();
+        if (benchFormat == "json")
+            bench.printJson();
+        else
+            bench.printCsv();
+        return 0;
+    }
+
+    if (levelCount > 0)
+    {
+        LevelPackBuilder builder(width, height, levelCount, levelStyle, density, threads, seed);
+        return builder.run(levelOutPath) ? 0 : 1;
+    }
+
+    if (!servePath.empty())
+    {
+        GameServer server(servePath, sizeGiven ? width : 120, sizeGiven ? height : 60, seed);
+        if (!server.open())
+            return 1;
+        server.run();
+        return 0;
+    }
+
+    if (!connectPath.empty())
+    {
+        MultiplayerClient client;
+        if (!client.connectTo(connectPath))
+            return 1;
+        client.run();
+        return 0;
+    }
+
+    if (!watchPath.empty())
+    {
+        SpectatorStream stream;
+        if (!stream.connectTo(watchPath))
+        {
+            cerr << "Cannot connect to " << watchPath << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        Game game(seed);
+        game.watch(stream);
+        return 0;
+    }
+
+    // A pack sets the board size unless --size picks which of its sizes to play
+    LevelPack levels;
+    if (!levelsPath.empty())
+    {
+        if (!levels.load(levelsPath) || levels.empty())
+        {
+            cerr << "Cannot read level pack: " << levelsPath << endl;
+            return 1;
+        }
+        if (!sizeGiven)
+        {
+            width = levels[0].width;
+            height = levels[0].height;
+            sizeGiven = true;
+        }
+    }
+
+    SpectatorFeed spectators;
+    if (!spectatePath.empty() && !spectators.open(spectatePath))
+    {
+        cerr << "Cannot listen on " << spectatePath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    if (!replayPath.empty())
+    {
+        ReplayReader replay;
+        if (!replay.open(replayPath))
+        {
+            cerr << "Cannot read replay: " << replayPath << endl;
+            return 1;
+        }
+        if (fastReplay)
+        {
+            FastReplayRunner runner(replay);
+            runner.setLevelPack(&levels);
+            if (!runner.run())
+                return 1;
+        }
+        else
+        {
+            Game game(seed);
+            game.setThreadedRendering(renderThread);
+            game.setLevelPack(&levels);
+            if (!spectatePath.empty())
+                game.setSpectatorFeed(&spectators);
+            if (!game.playReplay(replay))
+                return 1;
+        }
+        return 0;
+    }
+
+    if (batchGames > 0)
+    {
+        BatchRunner runner(width, height, batchGames, threads, seed);
+        runner.setAutopilot(autopilot);
+        runner.setLevelPack(&levels);
+        runner.run();
+        return 0;
+    }
+
+    if (headlessTicks > 0)
+    {
+        HeadlessRunner runner(width, height, headlessTicks, script, seed);
+        runner.setProfiling(profile);
+        runner.setAutopilot(autopilot);
+        runner.setSaveFile(savePath);
+        runner.setLevelPack(&levels);
+        if (!resumePath.empty() && !runner.resume(resumePath))
+        {
+            cerr << "Cannot load snapshot: " << resumePath << endl;
+            return 1;
+        }
+        runner.run();
+        return 0;
+    }
+
+    ReplayWriter recorder;
+    Game game(seed);
+    game.setThreadedRendering(renderThread);
+    game.setProfiling(profile);
+    game.setAutopilot(autopilot);
+    if (sizeGiven)
+        game.setBoardSize(width, height);
+    game.setSaveFile(savePath.empty() ? "snake_save.bin" : savePath);
+    game.setLevelPack(&levels);
+    if (!resumePath.empty() && !game.resume(resumePath))
+    {
+        cerr << "Cannot load snapshot: " << resumePath << endl;
+        return 1;
+    }
+    if (!spectatePath.empty())
+        game.setSpectatorFeed(&spectators);
+    if (!recordPath.empty())
+    {
+        if (!recorder.open(recordPath))
+        {
+            cerr << "Cannot write replay: " << recordPath << endl;
+            return 1;
+        }
+        game.setRecorder(&recorder);
+    }
     game.run();
     return 0;
 }